@@ -12,6 +12,25 @@
 // Inclusão de bibliotecas (se houver, como <Arduino.h>)
 // #include <Arduino.h>
 
+/**
+ * @defgroup HAL Camada de Abstração de Hardware
+ * @brief Pontos em que o firmware depende do hardware do Arduino.
+ * @details O motor de pads usa apenas a API do Arduino (micros(), millis(), digitalRead(),
+ * pinMode(), Serial), as funções `eeprom_*()` da avr-libc e as macros abaixo. Todo acesso direto a registradores do AVR
+ * (ADC, Timer1, Timer3) fica sob `#if defined(ARDUINO)`. Fora do Arduino, `sim/sim_hal.h`
+ * fornece versões nativas dessas funções, e o mesmo arquivo compila no computador para
+ * a simulação com traços gravados (ver `sim/drum_sim.cpp`).
+ * @{
+ */
+#if defined(ARDUINO)
+#include <avr/eeprom.h>
+#define HAL_ATOMIC_BEGIN() uint8_t halSavedSREG = SREG; cli() /**< Abre uma seção crítica (interrupções desligadas). */
+#define HAL_ATOMIC_END()   SREG = halSavedSREG               /**< Fecha a seção crítica, restaurando o SREG. */
+#else
+#include "sim/sim_hal.h"
+#endif
+/** @} */
+
 /**
  * @defgroup PAD_INDICES Índices dos Pads
  * @brief Definições dos índices numéricos para cada pad da bateria.
@@ -37,10 +56,53 @@
  * @{
  */
 const int PEDAL_CHIMBAL_PIN = 2; /**< Pino digital para o pedal do chimbal (com INPUT_PULLUP). */
+const uint8_t CONDUCAO_CHOKE_PIN = 13; /**< Chave de borda do prato de condução (com INPUT_PULLUP, LOW = abafado). */
+const uint8_t ATAQUE_CHOKE_PIN = 16;   /**< Chave de borda do prato de ataque (MOSI no conector ICSP). */
+#define NO_PIN 0xFF /**< Marca uma entrada digital não utilizada. */
+const uint8_t KIT_FOOTSWITCH_PIN = NO_PIN; /**< Pedal de troca de perfil (@ref KIT_PROFILES; INPUT_PULLUP, LOW = pressionado), ou `NO_PIN`. */
+
+/**
+ * @brief Número de multiplexadores analógicos CD74HC4067 (16 canais) ligados ao módulo.
+ * @details Com 0, cada sensor ocupa uma entrada analógica direta (A0-A11). Com
+ * multiplexadores, os quatro pinos de seleção (`muxSelectPin[]`) são compartilhados
+ * por todos eles, a saída comum de cada um vai a uma entrada analógica (`MUX_ADC_PINS`)
+ * e os sensores ligados a eles aparecem em `piezoPin[]` como `MUX_INPUT(mux, canal)`.
+ * Para acrescentar peças, basta aumentar `NUM_PADS`, dar índices aos novos sensores em
+ * @ref PAD_INDICES e descrevê-los em @ref PAD_TABLE, por exemplo:
+ * @code
+ * #define TOM3_PAD 11
+ * // piezoPin[]: ..., MUX_INPUT(0, 0)
+ * // padTable[]: { PAD_KIND_SIMPLE, 0, { TOM3_PAD, NO_SENSOR, NO_SENSOR, NO_SENSOR }, ... }
+ * @endcode
+ * @see SCAN_SAMPLE_RATE_HZ para o efeito do número de sensores na taxa de amostragem.
+ */
+#ifndef SCAN_MUX_COUNT
+#define SCAN_MUX_COUNT 0
+#endif
+
+#define MUX_CHANNELS 16 /**< Canais de cada multiplexador. */
+
+/** @brief Entrada `channel` do multiplexador `mux`, para uso em `piezoPin[]`. */
+#define MUX_INPUT(mux, channel) (0x80 | ((mux) << 4) | (channel))
+/** @brief Indica se uma entrada de `piezoPin[]` passa por um multiplexador. */
+#define MUX_IS_INPUT(pin)       (((pin) & 0x80) != 0)
+
+#if SCAN_MUX_COUNT > 0
+/** @brief Pinos digitais ligados a S0-S3 de todos os multiplexadores. */
+const uint8_t muxSelectPin[4] = { 3, 5, 7, 11 };
+
+/** @brief Entrada analógica ligada à saída comum (SIG) de cada multiplexador. */
+#ifndef MUX_ADC_PINS
+#define MUX_ADC_PINS { A11 }
+#endif
+const int muxAdcPin[] = MUX_ADC_PINS;
+static_assert(sizeof(muxAdcPin) / sizeof(muxAdcPin[0]) == SCAN_MUX_COUNT, "MUX_ADC_PINS deve ter SCAN_MUX_COUNT entradas");
+#endif
 
 /**
  * @brief Array que mapeia cada pad ao seu respectivo pino de entrada analógica.
  * A ordem dos pinos deve corresponder aos índices definidos em @ref PAD_INDICES.
+ * Sensores ligados a um multiplexador usam `MUX_INPUT(mux, canal)`.
  */
 const int piezoPin[NUM_PADS] = {
   A0,  // BUMBO
@@ -55,6 +117,27 @@ const int piezoPin[NUM_PADS] = {
   A9,  // ATAQUE_BORDA
   A10  // ATAQUE_CUPULA
 };
+
+/**
+ * @brief Tipo do pedal do chimbal.
+ * @details Com 0, o pedal é uma chave liga/desliga em `PEDAL_CHIMBAL_PIN`. Com 1, é um
+ * sensor contínuo (potenciômetro ou FSR) em `PEDAL_CHIMBAL_ANALOG_PIN`, lido pela
+ * varredura do ADC como um canal a mais e transmitido como CC4 (@ref HIHAT_PEDAL).
+ */
+#ifndef PEDAL_CHIMBAL_ANALOG
+#define PEDAL_CHIMBAL_ANALOG 0
+#endif
+
+#if PEDAL_CHIMBAL_ANALOG
+/** @brief Entrada analógica do pedal contínuo (aceita `MUX_INPUT(mux, canal)`). */
+#ifndef PEDAL_CHIMBAL_ANALOG_PIN
+#if SCAN_MUX_COUNT > 0
+#define PEDAL_CHIMBAL_ANALOG_PIN MUX_INPUT(0, 15)
+#else
+#define PEDAL_CHIMBAL_ANALOG_PIN A11
+#endif
+#endif
+#endif
 /** @} */
 
 /**
@@ -62,80 +145,395 @@ const int piezoPin[NUM_PADS] = {
  * @brief Definições das notas MIDI para cada peça da bateria.
  * @{
  */
-const int MIDI_NOTE_CHIMBAL_CLOSED = 42; /**< Nota MIDI para o chimbal fechado. */
-const int MIDI_NOTE_CHIMBAL_OPEN   = 46; /**< Nota MIDI para o chimbal aberto. */
-const int MIDI_NOTE_CHIMBAL_PEDAL  = 44; /**< Nota MIDI para o som do pedal do chimbal. */
-const int MIDI_NOTE_RIMSHOT        = 40; /**< Nota MIDI para o som de rimshot da caixa. */
+const int MIDI_NOTE_BUMBO           = 36; /**< Nota MIDI para o bumbo. */
+const int MIDI_NOTE_SURDO           = 41; /**< Nota MIDI para o surdo. */
+const int MIDI_NOTE_TOM1            = 43; /**< Nota MIDI para o tom 1. */
+const int MIDI_NOTE_TOM2            = 45; /**< Nota MIDI para o tom 2. */
+const int MIDI_NOTE_CHIMBAL_CLOSED  = 42; /**< Nota MIDI para o chimbal fechado. */
+const int MIDI_NOTE_CHIMBAL_OPEN    = 46; /**< Nota MIDI para o chimbal aberto. */
+const int MIDI_NOTE_CHIMBAL_HALF    = 46; /**< Nota MIDI para o chimbal semiaberto (no GM, a mesma do aberto; o CC4 diferencia). */
+const int MIDI_NOTE_CHIMBAL_PEDAL   = 44; /**< Nota MIDI para o som do pedal do chimbal. */
+const int MIDI_NOTE_CAIXA           = 38; /**< Nota MIDI para a pele da caixa. */
+const int MIDI_NOTE_ARO_CAIXA       = 39; /**< Nota MIDI para o aro da caixa. */
+const int MIDI_NOTE_RIMSHOT         = 40; /**< Nota MIDI para o som de rimshot da caixa. */
+const int MIDI_NOTE_CONDUCAO_BORDA  = 50; /**< Nota MIDI para a borda do prato de condução. */
+const int MIDI_NOTE_CONDUCAO_CUPULA = 53; /**< Nota MIDI para a cúpula do prato de condução. */
+const int MIDI_NOTE_ATAQUE_BORDA    = 49; /**< Nota MIDI para a borda do prato de ataque. */
+const int MIDI_NOTE_ATAQUE_CUPULA   = 51; /**< Nota MIDI para a cúpula do prato de ataque. */
+
+// Perfil de percussão (@ref KIT_PROFILES), com as notas do General MIDI
+const int MIDI_NOTE_CONGA_GRAVE     = 64; /**< Conga grave (surdo). */
+const int MIDI_NOTE_BONGO_AGUDO     = 60; /**< Bongô agudo (tom 1). */
+const int MIDI_NOTE_BONGO_GRAVE     = 61; /**< Bongô grave (tom 2). */
+const int MIDI_NOTE_TIMBAL_AGUDO    = 65; /**< Timbal agudo (pele da caixa). */
+const int MIDI_NOTE_CLAVES          = 75; /**< Claves (aro da caixa). */
+const int MIDI_NOTE_COWBELL         = 56; /**< Cowbell (borda da condução). */
+const int MIDI_NOTE_AGOGO_AGUDO     = 67; /**< Agogô agudo (cúpula da condução). */
+const int MIDI_NOTE_PANDEIRO        = 54; /**< Pandeiro (borda do ataque). */
+const int MIDI_NOTE_TRIANGULO       = 81; /**< Triângulo aberto (cúpula do ataque). */
+/** @} */
 
 /**
- * @brief Array que define a nota MIDI padrão para cada pad.
- * A ordem deve corresponder aos índices definidos em @ref PAD_INDICES.
+ * @defgroup TIMING Base de Tempo
+ * @brief Seleção da resolução de tempo usada pela máquina de estados.
+ * @details Com `PAD_TIMING_MICROS` em 1, o tempo é lido em microssegundos via micros(),
+ * o que permite janelas de pico de 2–3 ms sem o erro de ±1 ms do millis(). Em 0, a
+ * máquina de estados volta a usar millis(). As constantes de janela são sempre escritas
+ * em µs e convertidas para a base de tempo ativa por PAD_TIME().
+ *
+ * Os instantes guardados por peça (@ref PadRuntime) são ticks de 16 bits
+ * (`padTick_t`, 64 µs no modo em µs), o que cobre intervalos de até ~4,2 s com
+ * subtração modular. Isso basta para todas as janelas da máquina de estados.
+ * @{
  */
-const int midiNote[NUM_PADS] = {
-  36,  // BUMBO
-  41,  // SURDO
-  43,  // TOM1
-  45,  // TOM2
-  MIDI_NOTE_CHIMBAL_CLOSED, // CHIMBAL (nota padrão, muda com o pedal)
-  38,  // CAIXA
-  39,  // ARO_CAIXA
-  50,  // CONDUCAO_BORDA
-  53,  // CONDUCAO_CUPULA
-  49,  // ATAQUE_BORDA
-  51   // ATAQUE_CUPULA
-};
+#ifndef PAD_TIMING_MICROS
+#define PAD_TIMING_MICROS 1 /**< 1 = base de tempo em µs (micros()), 0 = em ms (millis()). */
+#endif
+
+/** @brief Tipo usado para todos os instantes e intervalos da máquina de estados. */
+typedef unsigned long padTime_t;
+
+#if PAD_TIMING_MICROS
+#define padNow() micros()       /**< Instante atual na base de tempo ativa. */
+#define PAD_TIME(us) (us)       /**< Converte um intervalo em µs para a base de tempo ativa. */
+#define PAD_TICK_SHIFT 6        /**< log2 da duração de um tick na base de tempo ativa. */
+#else
+#define padNow() millis()
+#define PAD_TIME(us) ((us) / 1000UL)
+#define PAD_TICK_SHIFT 0
+#endif
+
+/** @brief Instante curto (16 bits) guardado por peça; só diferenças são significativas. */
+typedef uint16_t padTick_t;
+
+#define PAD_TICK(time)   ((padTick_t)((time) >> PAD_TICK_SHIFT))       /**< Converte um instante padNow() em tick. */
+#define PAD_TICKS(us)    ((padTick_t)(PAD_TIME(us) >> PAD_TICK_SHIFT)) /**< Converte um intervalo em µs em ticks. */
+#define PAD_ELAPSED(now, since) ((padTick_t)((now) - (since)))         /**< Ticks decorridos, com volta modular. */
 /** @} */
 
 /**
  * @defgroup TUNING_PARAMETERS Parâmetros de Sensibilidade e Resposta
  * @brief Constantes para ajustar a sensibilidade, resposta e comportamento dos pads.
+ * @details Os limiares, ganhos e janelas de cada pad ficam na tabela @ref PAD_TABLE.
+ * @{
+ */
+
+/** @brief Velocidade MIDI mínima a ser enviada. */
+const int minVelocity = 10;
+/** @brief Velocidade MIDI máxima a ser enviada. */
+const int maxVelocity = 127;
+
+/**
+ * @brief Janela de tempo padrão (em µs) para detecção do valor de pico após um toque inicial.
+ * A lógica é não-bloqueante.
+ */
+const unsigned long PEAK_DETECTION_WINDOW_US = 7000;
+
+#define PEAK_ESTIMATOR_MAX       0 /**< Pico = maior amostra da janela. */
+#define PEAK_ESTIMATOR_PARABOLIC 1 /**< Pico = vértice da parábola pelas três amostras em torno da maior (@ref PEAK_ESTIMATION). */
+
+/** @brief Estimador do pico de cada toque (`PEAK_ESTIMATOR_*`). */
+#ifndef PEAK_ESTIMATOR
+#define PEAK_ESTIMATOR PEAK_ESTIMATOR_MAX
+#endif
+
+/**
+ * @brief Amostras seguidas em queda após o máximo que encerram a janela de pico antes do fim.
+ * @details Com 0, a janela de pico sempre dura até o fim (@ref PEAK_ESTIMATION).
+ */
+#ifndef PEAK_FALL_SAMPLES
+#define PEAK_FALL_SAMPLES 0
+#endif
+
+/**
+ * @brief 1 = peças com `PAD_FLAG_POSITION` enviam a posição do toque na pele antes da nota.
+ * @details Ver @ref HEAD_POSITION.
+ */
+#ifndef POSITION_SENSING
+#define POSITION_SENSING 0
+#endif
+
+/**
+ * @brief 1 = o limiar de cada sensor acompanha o ruído de fundo medido em repouso.
+ * @details Ver @ref NOISE_FLOOR.
+ */
+#ifndef NOISE_TRACKING
+#define NOISE_TRACKING 0
+#endif
+
+/**
+ * @brief 1 = inclui o modo de captura das amostras brutas pela serial USB.
+ * @details Ver @ref CAPTURE.
+ */
+#ifndef CAPTURE_ENABLED
+#define CAPTURE_ENABLED 1
+#endif
+
+/**
+ * @brief 1 = a varredura pula os sensores em debounce e dá as conversões liberadas aos
+ * sensores na janela de pico.
+ * @details Ver @ref SCAN_ENGINE.
+ */
+#ifndef SCAN_SCHEDULING
+#define SCAN_SCHEDULING 0
+#endif
+
+/**
+ * @brief 1 = o motor de pads é especializado por peça em tempo de compilação; 0 = um só
+ * passo genérico que lê a estrutura de cada peça da tabela.
+ * @details Ver @ref PAD_ENGINE.
+ */
+#ifndef PAD_ENGINE_STATIC
+#define PAD_ENGINE_STATIC 0
+#endif
+
+#define CHAIN_ROLE_NONE   0 /**< Placa única. */
+#define CHAIN_ROLE_MASTER 1 /**< Mestre: funde os eventos da placa secundária na sua saída MIDI. */
+#define CHAIN_ROLE_SLAVE  2 /**< Secundária: envia os seus eventos ao mestre em vez de sair em MIDI. */
+
+/**
+ * @brief Papel da placa num kit com várias placas (`CHAIN_ROLE_*`).
+ * @details Ver @ref CHAIN.
+ */
+#ifndef CHAIN_ROLE
+#define CHAIN_ROLE CHAIN_ROLE_NONE
+#endif
+
+/** @brief Indica se o motor acompanha cada amostra da janela de pico, e não só o máximo. */
+#define PEAK_TRACKING (PEAK_ESTIMATOR != PEAK_ESTIMATOR_MAX || PEAK_FALL_SAMPLES > 0 || POSITION_SENSING)
+
+/**
+ * @brief Multiplicador mínimo para o cálculo do retrigger dinâmico, evitando toques duplos em intensidades baixas.
+ * Em ponto fixo Q8 (256 = 1,0): 384 equivale a 1,5.
+ */
+const long RETRIGGER_MIN_MULTIPLIER_Q8 = 384;
+
+/** @brief Converte um fator real em ponto fixo Q8 (256 = 1,0) em tempo de compilação. */
+#define GAIN_Q8(x) ((uint16_t)((x) * 256 + 0.5))
+
+/** @brief Curvas de resposta de velocidade disponíveis para cada pad. */
+enum VelocityCurve {
+  VELOCITY_CURVE_LINEAR, /**< Velocidade proporcional à intensidade. */
+  VELOCITY_CURVE_LOG,    /**< Côncava: realça toques fracos. */
+  VELOCITY_CURVE_EXP,    /**< Convexa: reserva as velocidades altas para toques fortes. */
+  VELOCITY_CURVE_CUSTOM  /**< Forma definida em `velocityCurveCustom[]`. */
+};
+
+/** @brief Formas de decaimento do limiar de retrigger durante `PAD_STATE_REPIQUE_CHECK`. */
+enum RetriggerDecay {
+  RETRIGGER_DECAY_LINEAR, /**< Decaimento linear até o `threshold`. */
+  RETRIGGER_DECAY_EXP     /**< Decaimento exponencial, próximo da vibração residual do piezo. */
+};
+/** @} */
+
+/**
+ * @defgroup PAD_TABLE Tabela de Descrição dos Pads
+ * @brief Descrição constante (em PROGMEM) de cada peça da bateria.
+ * @details Cada entrada descreve uma peça completa: seus sensores (de uma a
+ * `PAD_MAX_ZONES` zonas, terminadas por `NO_SENSOR`), limiares, ganho, notas e o tipo de
+ * lógica de zona. O motor de pads (@ref PAD_ENGINE) percorre esta tabela; acrescentar uma
+ * peça é acrescentar uma linha aqui (e os seus sensores em @ref PAD_INDICES /
+ * `piezoPin[]`). Peças `PAD_KIND_ZONED` escolhem a zona tocada pelas regras de
+ * @ref ZONE_RULES.
+ * @warning Ajustes inadequados dos limiares podem causar toques fantasmas ou perda de sensibilidade.
  * @{
  */
+#define PAD_MAX_ZONES 4    /**< Número máximo de sensores (zonas) por peça. */
+#define NO_SENSOR     0xFF /**< Marca uma zona não utilizada em PadDescriptor::sensor. */
+
+/** @brief Tipo de lógica de zona aplicada quando um toque é validado. */
+enum PadKind {
+  PAD_KIND_SIMPLE,  /**< Uma nota, a da zona principal. */
+  PAD_KIND_HIHAT,   /**< Chimbal: nota fechada/semiaberta/aberta conforme o pedal. */
+  PAD_KIND_ZONED    /**< Várias zonas (caixa com aro, prato com cúpula e borda): nota pelas regras de @ref ZONE_RULES. */
+};
+
+#define PAD_FLAG_CHOKE         0x01 /**< A peça aceita choke (abafamento) pela chave em PadDescriptor::chokePin. */
+#define PAD_FLAG_POSITION      0x02 /**< A peça envia a posição do toque na pele (@ref HEAD_POSITION); zona 0 no centro, zona 1 na borda. */
+
+#define PAD_WINDOW_DEFAULT 0 /**< PadDescriptor::peakWindowUs: usa a janela global `padWindows.peakDetectionUs`. */
+
+/** @brief Descrição constante de uma peça da bateria. */
+struct PadDescriptor {
+  uint8_t kind;                      /**< Lógica de zona (@ref PadKind). */
+  uint8_t flags;                     /**< Combinação de `PAD_FLAG_*`. */
+  uint8_t sensor[PAD_MAX_ZONES];     /**< Sensores da peça (@ref PAD_INDICES), a partir da zona principal; `NO_SENSOR` nas sobras. */
+  int threshold[PAD_MAX_ZONES];      /**< Limiar mínimo de leitura de cada zona para registrar um toque. */
+  int retrigger;                     /**< Limiar de retrigger usado durante a checagem de repique. */
+  uint16_t gainQ8[PAD_MAX_ZONES];    /**< Fator de ganho de cada zona em Q8 (ex.: cúpulas têm sinal mais fraco). */
+  uint8_t curve;                     /**< Curva de velocidade (@ref VelocityCurve). */
+  uint8_t decay;                     /**< Forma de decaimento do retrigger (@ref RetriggerDecay). */
+  uint8_t ringHalfLifeMs;            /**< Meia-vida da vibração residual descontada do toque seguinte (@ref RESIDUAL_ENERGY), ou 0 para nunca. */
+  uint8_t note[PAD_MAX_ZONES];       /**< Nota MIDI de cada zona. */
+  unsigned int peakWindowUs;         /**< Janela de detecção de pico (em µs), ou `PAD_WINDOW_DEFAULT`; pads rápidos podem usar 2–3 ms. */
+  uint8_t chokePin;                  /**< Entrada da chave de choke (LOW = abafado), ou `NO_PIN`. */
+  uint16_t gateMs;                   /**< Duração das notas até o note-off automático (@ref VOICES), ou 0 para nunca. */
+};
 
 /**
- * @brief Limiar mínimo de leitura do sensor para registrar um toque.
- * Leituras abaixo deste valor são ignoradas. Ajustável por pad.
+ * @brief Tabela de peças da bateria (valores de fábrica).
+ * @details Copiada para `padConfig[]` no `setup()`; a cópia em RAM é a que o motor usa
+ * e a que pode ser ajustada por SysEx e gravada na EEPROM (@ref CONFIG).
+ * @note Os limiares de retrigger iniciais são baseados em `threshold * 1.8`.
+ * @note Só a caixa, a peça dos rufos, desconta a vibração residual (@ref RESIDUAL_ENERGY):
+ * 15 ms, abaixo dos ~21 ms medidos numa pele de decaimento de 30 ms, pois uma meia-vida
+ * longa demais come os acentos e uma curta só corrige menos. As outras peças ficam em 0
+ * até serem medidas na pele e afinação em uso.
  */
-const int threshold[NUM_PADS] = {
-  120, 45, 230, 150, 80, 55, 40, 35, 35, 35, 35
+constexpr PadDescriptor padTable[] PROGMEM = {
+  // kind             flags              sensores (zonas)                                                   threshold          retr.    ganho                                                 curva                  decaimento              resid. notas                                                          janela              choke               gate
+  { PAD_KIND_SIMPLE, 0,                 { BUMBO_PAD,          NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 120,  0, 0, 0 }, 900, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_BUMBO,          0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { SURDO_PAD,          NO_SENSOR,           NO_SENSOR, NO_SENSOR }, {  45,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_SURDO,          0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { TOM1_PAD,           NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 230,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_TOM1,           0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { TOM2_PAD,           NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 150,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_TOM2,           0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_HIHAT,  0,                 { CHIMBAL_PAD,        NO_SENSOR,           NO_SENSOR, NO_SENSOR }, {  80,  0, 0, 0 }, 900, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_CHIMBAL_CLOSED, 0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,             1000 },
+  { PAD_KIND_ZONED,  PAD_FLAG_POSITION, { CAIXA_PAD,          ARO_CAIXA_PAD,       NO_SENSOR, NO_SENSOR }, {  55, 40, 0, 0 }, 550, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 15,    { MIDI_NOTE_CAIXA,          MIDI_NOTE_ARO_CAIXA,       0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_ZONED,  PAD_FLAG_CHOKE,    { CONDUCAO_BORDA_PAD, CONDUCAO_CUPULA_PAD, NO_SENSOR, NO_SENSOR }, {  35, 35, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(7),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_CONDUCAO_BORDA, MIDI_NOTE_CONDUCAO_CUPULA, 0, 0 }, PAD_WINDOW_DEFAULT, CONDUCAO_CHOKE_PIN, 2000 },
+  { PAD_KIND_ZONED,  PAD_FLAG_CHOKE,    { ATAQUE_BORDA_PAD,   ATAQUE_CUPULA_PAD,   NO_SENSOR, NO_SENSOR }, {  35, 35, 0, 0 }, 680, { GAIN_Q8(1), GAIN_Q8(1.2), GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_ATAQUE_BORDA,   MIDI_NOTE_ATAQUE_CUPULA,   0, 0 }, PAD_WINDOW_DEFAULT, ATAQUE_CHOKE_PIN,   2000 }
+};
+
+/** @brief Número de peças descritas em `padTable[]`. */
+#define NUM_KIT_PADS (sizeof(padTable) / sizeof(padTable[0]))
+
+/** @brief Índices das peças em `padTable[]` (mesma ordem da tabela). */
+enum KitPiece {
+  KIT_BUMBO, KIT_SURDO, KIT_TOM1, KIT_TOM2, KIT_CHIMBAL, KIT_CAIXA, KIT_CONDUCAO, KIT_ATAQUE
 };
+static_assert(KIT_ATAQUE + 1 == NUM_KIT_PADS, "KitPiece deve seguir a ordem de padTable[]");
+
+/** @brief Configuração em uso de cada peça (cópia em RAM de `padTable[]`, ajustável). */
+PadDescriptor padConfig[NUM_KIT_PADS];
+
+/**
+ * @brief Número de zonas de uma peça: sensores antes do primeiro `NO_SENSOR`.
+ * @details `constexpr` para valer também sobre `padTable[]` em tempo de compilação
+ * (@ref PAD_ENGINE); `from` é só o índice da recursão.
+ */
+constexpr uint8_t padZones(const PadDescriptor &d, uint8_t from = 1) {
+  return (from < PAD_MAX_ZONES && d.sensor[from] != NO_SENSOR) ? padZones(d, from + 1) : from;
+}
+/** @} */
 
 /**
- * @brief Limiar de retrigger usado durante a checagem de repique.
- * Define o valor que uma nova leitura deve exceder para ser considerada um novo toque
- * logo após um toque inicial.
- * @note Os valores iniciais são baseados em `threshold[j] * 1.8`.
+ * @defgroup ZONE_RULES Regras de Zona
+ * @brief Classificação da zona tocada nas peças `PAD_KIND_ZONED`, uma vez por toque.
+ * @details Cada regra pertence a uma peça e compara o pico de uma zona (`zone`) com o de
+ * uma zona de referência (`reference`). As regras de uma peça são testadas na ordem da
+ * tabela; a primeira em que todas as condições valem decide a nota e a velocidade. Se
+ * nenhuma vale, toca a zona principal. As condições são:
+ * - razão: `pico[zone] * ratioDen > pico[reference] * ratioNum`;
+ * - limiar: `pico[zone] > threshold[zone] * thresholdMul` (sem teste com 0);
+ * - faixa: `referenceMin <= pico[reference] < referenceMax`.
+ *
+ * A classificação só roda ao fim da janela de pico, em padEmitHit(): acrescentar zonas
+ * ou regras não pesa na varredura. As regras ficam em RAM (`zoneRules[]`), são
+ * ajustáveis por SysEx (`SYSEX_CMD_RULE_SET`) e gravadas na EEPROM com o resto da
+ * configuração (@ref CONFIG). Um prato de condução de três zonas (arco, cúpula e borda),
+ * por exemplo, seria descrito assim:
+ * @code
+ * // padTable[]: { PAD_KIND_ZONED, PAD_FLAG_CHOKE, { RIDE_ARCO_PAD, RIDE_CUPULA_PAD, RIDE_BORDA_PAD, NO_SENSOR }, ... }
+ * // zoneRuleTable[]:
+ * { KIT_RIDE, 1, 0, 1, 1, 0, 0, 1000,          ZONE_NOTE_OF_ZONE, ZONE_VELOCITY_ZONE }, // cúpula maior que o arco
+ * { KIT_RIDE, 2, 0, 4, 5, 0, 0, ZONE_NO_LIMIT, ZONE_NOTE_OF_ZONE, ZONE_VELOCITY_MAX  }, // borda acima de 80% do arco
+ * @endcode
+ * @{
  */
-const int retriggerThreshold[NUM_PADS] = {
-  900, 950, 950, 950, 900, 550, 100, 950, 950, 680, 680
+#define ZONE_RULE_MAX      8    /**< Capacidade da tabela de regras. */
+#define ZONE_RULE_UNUSED   0xFF /**< ZoneRule::pad de uma posição livre. */
+#define ZONE_NOTE_OF_ZONE  0xFF /**< ZoneRule::note: usa a nota da zona testada (`note[zone]`). */
+#define ZONE_NO_LIMIT      1024 /**< ZoneRule::referenceMax sem limite (acima de qualquer leitura). */
+#define ZONE_RULE_FIELDS   10   /**< Campos de ZoneRule trocados por SysEx. */
+
+/** @brief Velocidade enviada quando uma regra vale. */
+enum ZoneVelocity {
+  ZONE_VELOCITY_ZONE, /**< Velocidade da zona testada. */
+  ZONE_VELOCITY_MAX   /**< Maior velocidade entre a zona testada e a de referência. */
 };
 
-/** @brief Velocidade MIDI mínima a ser enviada. */
-const int minVelocity = 10;
-/** @brief Velocidade MIDI máxima a ser enviada. */
-const int maxVelocity = 127;
+/** @brief Regra de classificação de zona. @see ZONE_RULES */
+struct ZoneRule {
+  uint8_t pad;           /**< Peça em `padTable[]`, ou `ZONE_RULE_UNUSED`. */
+  uint8_t zone;          /**< Zona testada. */
+  uint8_t reference;     /**< Zona de referência. */
+  uint8_t ratioNum;      /**< Numerador da razão mínima `pico[zone] / pico[reference]`. */
+  uint8_t ratioDen;      /**< Denominador da razão mínima (maior que zero). */
+  uint8_t thresholdMul;  /**< Múltiplo do `threshold` da zona que o pico precisa passar, ou 0. */
+  uint16_t referenceMin; /**< Menor pico aceito na zona de referência. */
+  uint16_t referenceMax; /**< Pico da zona de referência a partir do qual a regra não vale. */
+  uint8_t note;          /**< Nota enviada, ou `ZONE_NOTE_OF_ZONE`. */
+  uint8_t velocity;      /**< @ref ZoneVelocity. */
+};
 
 /**
- * @brief Fator de ganho para amplificar o sinal de certos pads.
- * Útil para sensores com sinal naturalmente mais fraco, como os de cúpula.
+ * @brief Regras de fábrica.
+ * @details Reproduzem a lógica fixa anterior: rimshot com pele acima de 600 e aro acima
+ * do dobro do seu limiar; aro acima de 10/11 da pele sem pele saturada; cúpula maior que
+ * a borda sem borda saturada.
  */
-const float gainFactor[NUM_PADS] = {
-  1, 1, 1, 1, 1, 1, 1, 1, 7, 1, 1.2
+const ZoneRule zoneRuleTable[] PROGMEM = {
+  // peça        zona ref razão    limiar faixa da referência  nota               velocidade
+  { KIT_CAIXA,    1,   0,  0,  1,   2,     601, ZONE_NO_LIMIT,   MIDI_NOTE_RIMSHOT, ZONE_VELOCITY_MAX  }, // rimshot (pele > 600)
+  { KIT_CAIXA,    1,   0,  10, 11,  0,     0,   1000,            ZONE_NOTE_OF_ZONE, ZONE_VELOCITY_ZONE }, // aro
+  { KIT_CONDUCAO, 1,   0,  1,  1,   0,     0,   1000,            ZONE_NOTE_OF_ZONE, ZONE_VELOCITY_ZONE }, // cúpula
+  { KIT_ATAQUE,   1,   0,  1,  1,   0,     0,   1000,            ZONE_NOTE_OF_ZONE, ZONE_VELOCITY_ZONE }  // cúpula
 };
 
+static_assert(sizeof(zoneRuleTable) <= ZONE_RULE_MAX * sizeof(ZoneRule), "zoneRuleTable[] deve caber em ZONE_RULE_MAX regras");
+
+/** @brief Regras em uso (cópia em RAM de `zoneRuleTable[]`, ajustável). */
+ZoneRule zoneRules[ZONE_RULE_MAX];
+
+/** @brief Restaura as regras de fábrica; as posições restantes ficam livres. */
+void zoneRulesDefaults() {
+  memset(zoneRules, ZONE_RULE_UNUSED, sizeof(zoneRules));
+  memcpy_P(zoneRules, zoneRuleTable, sizeof(zoneRuleTable));
+}
+
 /**
- * @brief Janela de tempo (em ms) para detecção do valor de pico após um toque inicial.
- * A lógica é não-bloqueante.
+ * @brief Escolhe a regra que vale para um toque.
+ * @param p Índice da peça em `padTable[]`.
+ * @param d Descrição da peça.
+ * @param peak Pico de cada zona.
+ * @return A primeira regra da peça cujas condições valem, ou nulo.
  */
-const unsigned long PEAK_DETECTION_WINDOW_MS = 7;
+const ZoneRule *zoneClassify(uint8_t p, const PadDescriptor &d, const uint16_t *peak) {
+  uint8_t zones = padZones(d);
+  for (uint8_t i = 0; i < ZONE_RULE_MAX; i++) {
+    const ZoneRule &rule = zoneRules[i];
+    if (rule.pad != p || rule.zone >= zones || rule.reference >= zones) continue;
+    long zonePeak = peak[rule.zone];
+    long referencePeak = peak[rule.reference];
+    if (zonePeak * rule.ratioDen <= referencePeak * rule.ratioNum) continue;
+    if (rule.thresholdMul && zonePeak <= (long)d.threshold[rule.zone] * rule.thresholdMul) continue;
+    if (referencePeak < rule.referenceMin || referencePeak >= rule.referenceMax) continue;
+    return &rule;
+  }
+  return NULL;
+}
 
-/** @brief Multiplicador mínimo para o cálculo do retrigger dinâmico, evitando toques duplos em intensidades baixas. */
-const float RETRIGGER_MIN_MULTIPLIER = 1.5;
+/**
+ * @brief Substitui uma regra em uso (só na RAM; a EEPROM é gravada por configSave()).
+ * @param index Posição em `zoneRules[]`.
+ * @param rule Nova regra; `pad` em `ZONE_RULE_UNUSED` libera a posição.
+ * @return `false` se a posição ou algum campo forem inválidos.
+ */
+bool zoneRuleSet(uint8_t index, const ZoneRule &rule) {
+  if (index >= ZONE_RULE_MAX) return false;
+  if (rule.pad != ZONE_RULE_UNUSED) {
+    if (rule.pad >= NUM_KIT_PADS || rule.zone >= PAD_MAX_ZONES || rule.reference >= PAD_MAX_ZONES) return false;
+    if (rule.ratioDen == 0 || rule.referenceMax > ZONE_NO_LIMIT) return false;
+    if (rule.note > 127 && rule.note != ZONE_NOTE_OF_ZONE) return false;
+    if (rule.velocity > ZONE_VELOCITY_MAX) return false;
+  }
+  zoneRules[index] = rule;
+  return true;
+}
 /** @} */
 
 /**
  * @defgroup STATE_MACHINE Máquina de Estados e Debounce
  * @brief Definições e variáveis para a máquina de estados que controla cada pad.
+ * @details O estado é mantido por peça (entrada de `padTable[]`), e não por sensor.
  * @{
  */
 
@@ -145,35 +543,156 @@ enum PadState {
   PAD_STATE_PEAK_DETECTION,   /**< Coletando leituras para encontrar o valor de pico do toque. */
   PAD_STATE_SILENT_DEBOUNCE,  /**< Período de silêncio para ignorar ruído imediato após um toque. */
   PAD_STATE_REPIQUE_CHECK,    /**< Período de verificação de repique com limiar dinâmico. */
-  PAD_STATE_CHOKE_CONFIRMATION /**< Estado para confirmar se um toque foi um choke no prato. */
+  PAD_STATE_CHOKE_CONFIRMATION /**< Chave de choke pressionada: confirmando que o prato foi abafado. */
+};
+
+/** @brief Duração (em µs) do estado de silêncio total (debounce). */
+const unsigned long SILENT_DEBOUNCE_US = 30000;
+/** @brief Duração (em µs) do estado de checagem de repique. */
+const unsigned long REPIQUE_CHECK_US = 180000;
+/** @brief Tempo (em µs) que a chave de choke precisa ficar pressionada para abafar o prato. */
+const unsigned long CHOKE_CONFIRMATION_TIME_US = 20000;
+
+/**
+ * @brief Janelas de tempo da máquina de estados em uso (em µs).
+ * @details Começam com os valores padrão acima e ficam em RAM para poderem ser
+ * ajustadas sem recompilar, por SysEx (@ref CONFIG) ou pela bancada `sim/bench.cpp`.
+ */
+struct PadWindows {
+  unsigned long peakDetectionUs;     /**< Janela de pico das peças com `PAD_WINDOW_DEFAULT`. */
+  unsigned long silentDebounceUs;    /**< Duração de `PAD_STATE_SILENT_DEBOUNCE`. */
+  unsigned long repiqueCheckUs;      /**< Duração de `PAD_STATE_REPIQUE_CHECK`. */
+  unsigned long chokeConfirmationUs; /**< Duração de `PAD_STATE_CHOKE_CONFIRMATION`. */
+};
+
+/** @brief Janelas de fábrica. */
+const PadWindows padWindowsDefaults = { PEAK_DETECTION_WINDOW_US, SILENT_DEBOUNCE_US, REPIQUE_CHECK_US, CHOKE_CONFIRMATION_TIME_US };
+/** @brief Janelas em uso (ajustáveis por SysEx, ver @ref CONFIG). @see PadWindows */
+PadWindows padWindows = padWindowsDefaults;
+
+/**
+ * @brief Estado de execução de uma peça.
+ * @details Tudo o que o motor lê e escreve a cada passo de uma peça fica numa estrutura
+ * só, com os tipos mais estreitos possíveis. O passo carrega o endereço de
+ * `padRuntime[p]` uma vez e acessa os campos por deslocamento fixo. No AVR ocupa 25 bytes
+ * por peça, ou 57 com `PEAK_TRACKING` (conferido por `static_assert` logo abaixo).
+ */
+struct PadRuntime {
+  uint8_t state;                 /**< Estado atual (@ref PadState). */
+  uint8_t retriggerStep;         /**< Degrau atual do decaimento (@ref RETRIGGER_DECAY). */
+  uint8_t chokeHeld;             /**< Choke já enviado; só volta a 0 quando a chave é solta. */
+  padTick_t stateTick;           /**< Instante da última mudança de estado. */
+  padTick_t onsetTick;           /**< Instante em que o toque atual cruzou o limiar. */
+  padTick_t retriggerNextTick;   /**< Ticks desde a entrada em `PAD_STATE_REPIQUE_CHECK` até o próximo degrau. */
+  uint16_t peak[PAD_MAX_ZONES];  /**< Pico de cada zona no toque atual. */
+  uint16_t crosstalkPeak;        /**< Maior pico entre as zonas no toque mais recente (@ref CROSSTALK_LOGIC). */
+  uint16_t retriggerInitial;     /**< Limiar de retrigger no início do decaimento. */
+  uint16_t retriggerLevel;       /**< Limiar de retrigger do degrau atual. */
+  uint16_t ringLevel;            /**< Vibração residual esperada no início do toque atual (@ref RESIDUAL_ENERGY). */
+#if PEAK_TRACKING
+  uint16_t peakBefore[PAD_MAX_ZONES]; /**< Amostra anterior ao máximo de cada zona (`PEAK_NO_SAMPLE` se não houver). */
+  uint16_t peakAfter[PAD_MAX_ZONES];  /**< Amostra seguinte ao máximo de cada zona. */
+  uint16_t lastSample[PAD_MAX_ZONES]; /**< Última amostra de cada zona. */
+  uint8_t sinceMax[PAD_MAX_ZONES];    /**< Amostras desde o máximo de cada zona (satura em 255). */
+  uint8_t falling[PAD_MAX_ZONES];     /**< Amostras seguidas em queda de cada zona. */
+#endif
 };
+#if defined(__AVR__)
+static_assert(sizeof(PadRuntime) == 25 + (PEAK_TRACKING ? 32 : 0), "Atualize o tamanho de PadRuntime na documentação");
+#endif
 
-/** @brief Duração (em ms) do estado de silêncio total (debounce). */
-const unsigned long SILENT_DEBOUNCE_MS = 30;
-/** @brief Duração (em ms) do estado de checagem de repique. */
-const unsigned long REPIQUE_CHECK_MS = 180;
-/** @brief Duração (em ms) do tempo de confirmação do choke. */
-const unsigned long CHOKE_CONFIRMATION_TIME_MS = 20;
+/** @brief Estado de execução de cada peça, na ordem de `padTable[]`. */
+PadRuntime padRuntime[NUM_KIT_PADS];
 
-/** @brief Array que armazena o estado atual de cada pad. @see PadState */
-PadState padState[NUM_PADS];
-/** @brief Array que armazena o tempo (millis()) da última mudança de estado de cada pad. */
-unsigned long stateChangeTime[NUM_PADS];
+/**
+ * @brief Instante completo (padNow()) em que o toque atual de uma peça cruzou o limiar.
+ * @param p Índice da peça em `padTable[]`.
+ */
+inline padTime_t padOnsetTime(uint8_t p) {
+  padTime_t now = padNow();
+  return now - ((padTime_t)PAD_ELAPSED(PAD_TICK(now), padRuntime[p].onsetTick) << PAD_TICK_SHIFT);
+}
 /** @} */
 
 /**
  * @defgroup CROSSTALK_LOGIC Lógica de Eliminação de Crosstalk
- * @brief Constantes e variáveis para o algoritmo de rejeição de crosstalk.
+ * @brief Matriz de vazamento entre peças e rejeição de toques que são só vazamento.
+ * @details Cada peça guarda o maior valor lido no seu toque mais recente
+ * (PadRuntime::crosstalkPeak) e o instante de início (PadRuntime::onsetTick). Um toque
+ * em outra peça só é descartado se o seu pico não passar do vazamento esperado de uma
+ * peça acoplada que começou a soar há pouco: `pico <= crosstalkPeak[origem] * ratio`,
+ * dentro de `window`. O pico é zerado quando a peça volta a `PAD_STATE_IDLE` e já passou
+ * a maior janela possível (`CROSSTALK_MAX_WINDOW_MS`), para que um instante antigo não
+ * pareça recente após a volta dos ticks de 16 bits.
  * @{
  */
-/** @brief Registra o tempo do último MIDI enviado com alta velocidade. */
-unsigned long lastHighVelocityMidiTime = 0;
-/** @brief Limiar de velocidade para considerar uma batida "forte". */
-const int HIGH_VELOCITY_THRESHOLD = 115;
-/** @brief Batidas com velocidade abaixo deste limiar serão descartadas se ocorrerem dentro da janela de crosstalk. */
-const int LOW_VELOCITY_DISCARD_THRESHOLD = 29;
-/** @brief Janela de tempo (em ms) após uma batida forte para ignorar batidas fracas (crosstalk). */
-const unsigned long CROSSTALK_WINDOW_MS = 130;
+
+/** @brief Acoplamento de uma peça de origem para uma peça vítima. */
+struct CrosstalkCoeff {
+  uint8_t ratioQ8;  /**< Pico esperado na vítima em relação ao pico da origem (Q8: 256 = 1,0). */
+  uint8_t windowMs; /**< Até quanto tempo (em ms) após o início do toque da origem o vazamento aparece; 0 = sem acoplamento. */
+};
+
+/** @brief Converte uma razão e uma janela em ms num @ref CrosstalkCoeff. */
+#define XTALK(ratio, ms) { (uint8_t)((ratio) * 256 + 0.5), (ms) }
+#define XTALK_NONE { 0, 0 } /**< Sem acoplamento (diagonal da matriz). */
+
+/**
+ * @brief Matriz de crosstalk de fábrica: `[origem][vítima]`, na ordem de `padTable[]`.
+ * @details Valores estimados para um kit montado no mesmo rack: 10% entre quaisquer
+ * peças e mais entre vizinhas (bumbo → surdo/caixa/tom 1, toms entre si, caixa ↔
+ * chimbal, toms → pratos próximos).
+ */
+const CrosstalkCoeff crosstalkDefaults[NUM_KIT_PADS][NUM_KIT_PADS] PROGMEM = {
+  //            BUMBO             SURDO             TOM1              TOM2              CHIMBAL           CAIXA             CONDUCAO          ATAQUE
+  /* BUMBO  */ { XTALK_NONE,       XTALK(0.15, 30),  XTALK(0.15, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.15, 30),  XTALK(0.10, 30),  XTALK(0.10, 30) },
+  /* SURDO  */ { XTALK(0.10, 30),  XTALK_NONE,       XTALK(0.10, 30),  XTALK(0.12, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.12, 30),  XTALK(0.10, 30) },
+  /* TOM1   */ { XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK_NONE,       XTALK(0.20, 30),  XTALK(0.10, 30),  XTALK(0.18, 30),  XTALK(0.10, 30),  XTALK(0.15, 30) },
+  /* TOM2   */ { XTALK(0.10, 30),  XTALK(0.12, 30),  XTALK(0.20, 30),  XTALK_NONE,       XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.15, 30),  XTALK(0.10, 30) },
+  /* CHIMB. */ { XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK_NONE,       XTALK(0.12, 30),  XTALK(0.10, 30),  XTALK(0.10, 30) },
+  /* CAIXA  */ { XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.18, 30),  XTALK(0.10, 30),  XTALK(0.15, 30),  XTALK_NONE,       XTALK(0.10, 30),  XTALK(0.10, 30) },
+  /* COND.  */ { XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK_NONE,       XTALK(0.10, 30) },
+  /* ATAQUE */ { XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK(0.10, 30),  XTALK_NONE      }
+};
+
+/** @brief Matriz de crosstalk em uso (cópia em RAM de `crosstalkDefaults`, ajustável). */
+CrosstalkCoeff crosstalkMatrix[NUM_KIT_PADS][NUM_KIT_PADS];
+
+#define CROSSTALK_MAX_WINDOW_MS 255 /**< Maior janela representável em CrosstalkCoeff::windowMs. */
+
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+/**
+ * @brief Acoplamento de qualquer peça da outra placa (@ref CHAIN) para as peças desta.
+ * @details As placas só trocam o pico e o instante de cada toque, não a identidade da
+ * peça na matriz, então a outra placa conta como uma única peça de origem.
+ */
+const CrosstalkCoeff crosstalkRemote = XTALK(0.10, 30);
+uint16_t crosstalkRemotePeak = 0;      /**< Pico do toque mais recente na outra placa (0 = nenhum). */
+padTick_t crosstalkRemoteTick;         /**< Início desse toque, no tempo desta placa. */
+#endif
+
+/**
+ * @brief Verifica se um toque pode ser apenas vazamento de um toque recente em outra peça.
+ * @param p Peça vítima, em `padTable[]`.
+ * @param peak Maior pico do toque entre as zonas da vítima.
+ * @param now Instante atual (padTick()).
+ * @return `true` se `peak` não passa do vazamento esperado de alguma peça acoplada.
+ */
+bool crosstalkSuspect(uint8_t p, int peak, padTick_t now) {
+  for (uint8_t s = 0; s < NUM_KIT_PADS; s++) {
+    const CrosstalkCoeff &c = crosstalkMatrix[s][p];
+    const PadRuntime &source = padRuntime[s];
+    if (s == p || c.windowMs == 0 || source.crosstalkPeak == 0) continue;
+    if (PAD_ELAPSED(now, source.onsetTick) >= PAD_TICKS(c.windowMs * 1000UL)) continue;
+    if (peak <= (int)(((long)source.crosstalkPeak * c.ratioQ8) >> 8)) return true;
+  }
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+  if (crosstalkRemotePeak && PAD_ELAPSED(now, crosstalkRemoteTick) < PAD_TICKS(crosstalkRemote.windowMs * 1000UL)) {
+    if (peak <= (int)(((long)crosstalkRemotePeak * crosstalkRemote.ratioQ8) >> 8)) return true;
+  }
+#endif
+  return false;
+}
 /** @} */
 
 /**
@@ -182,502 +701,3947 @@ const unsigned long CROSSTALK_WINDOW_MS = 130;
  * @{
  */
 
-/** @brief Array que armazena o valor de pico lido para cada pad. */
-int peakSensorValues[NUM_PADS] = {0};
-/** @brief Array que armazena o tempo (millis()) em que o pico foi detectado para cada pad. */
-unsigned long peakFoundTime[NUM_PADS] = {0};
-/** @brief Armazena o valor inicial do limiar de retrigger para o decaimento linear. */
-int retriggerThresholdInitialDecay[NUM_PADS];
-
 // --- Variáveis de Estado para o Pedal do Chimbal ---
-int pedalChimbalState = HIGH;         /**< Estado atual do pedal do chimbal (HIGH = solto, LOW = pressionado). */
-int lastPedalChimbalState = HIGH;     /**< Último estado registrado do pedal, para detecção de mudança. */
-bool chimbalOpenSoundPlaying = false;   /**< Flag que indica se a nota de chimbal aberto está soando. */
-bool chimbalClosedSoundPlaying = false; /**< Flag que indica se a nota de chimbal fechado está soando. */
-
-// --- Flags para controle de notas (Choke) ---
-bool conducaoBordaPlaying = false; /**< Flag que indica se a nota da borda da condução está soando. */
-bool conducaoCupulaPlaying = false;/**< Flag que indica se a nota da cúpula da condução está soando. */
-bool ataqueBordaPlaying = false;   /**< Flag que indica se a nota da borda do ataque está soando. */
-bool ataqueCupulaPlaying = false;  /**< Flag que indica se a nota da cúpula do ataque está soando. */
-bool caixaPlaying = false;         /**< Flag que indica se a nota da pele da caixa está soando. */
-bool aroCaixaPlaying = false;      /**< Flag que indica se a nota do aro da caixa está soando. */
+int lastPedalChimbalState = HIGH;     /**< Último estado registrado do pedal digital, para detecção de mudança. */
+uint8_t pedalPosition = 0;            /**< Posição do pedal do chimbal: 0 = solto (aberto) a 127 = fechado. */
 /** @} */
 
-/** 
- * @defgroup INICIALIZACAO Função de inicialização do Arduino.
- * @brief Configura a comunicação Serial/MIDI, os pinos dos sensores e inicializa
- * as variáveis de estado de todos os pads.
- * 
- * Inclui a função `setup()` e variáveis associadas à etapa inicial.
+/**
+ * @defgroup SCAN_ENGINE Motor de Varredura do ADC
+ * @brief Leitura dos sensores por interrupção, substituindo o `analogRead()` bloqueante.
+ * @details O Timer1 dispara o ADC (modo auto-trigger) a uma taxa fixa e uma interrupção
+ * por conversão percorre `piezoPin[]`, gravando cada amostra no buffer circular
+ * do respectivo pad e atualizando um registrador de pico. O `loop()` não espera mais
+ * por conversões: apenas consome, via scanTake(), o maior valor amostrado desde a
+ * última leitura do pad, de modo que nenhum transiente é perdido entre duas passagens.
+ *
+ * A varredura é um pipeline de dois estágios. A interrupção roda logo depois que o ADC
+ * retém a amostra do sensor atual (`TIMER1_COMPC`, alguns ciclos de ADC após o disparo).
+ * Ela lê o resultado do sensor anterior e já seleciona o canal do próximo, tanto no ADC
+ * quanto nos multiplexadores (@ref SCAN_MUX_COUNT). Assim, a acomodação da saída do
+ * multiplexador acontece durante a conversão em andamento, e não antes da próxima.
+ *
+ * Com o pedal contínuo (@ref PEDAL_CHIMBAL_ANALOG), cada varredura tem um canal a mais,
+ * `SCAN_PEDAL_CHANNEL`, que não passa pelo buffer dos pads: a amostra vai direto para
+ * um filtro passa-baixas (scanStorePedal()).
+ *
+ * Com `SCAN_SCHEDULING`, a ordem das conversões sai de uma agenda (`scanSchedule[]`) de
+ * `SCAN_CHANNELS` posições por passagem, remontada pelo `loop()` quando o estado das peças
+ * muda (padScheduleUpdate()). Os sensores de peças em `PAD_STATE_SILENT_DEBOUNCE`, cuja
+ * leitura seria descartada, saem da agenda, e as posições liberadas vão para os sensores
+ * em `PAD_STATE_PEAK_DETECTION`. Todo sensor fora do debounce tem ao menos uma conversão
+ * por passagem, ou seja, nunca é lido abaixo de `SCAN_SAMPLE_RATE_HZ`; a taxa total de
+ * conversões não muda. Com vários toques seguidos, o pico de cada toque é amostrado a uma
+ * taxa maior e o início do toque seguinte é visto mais cedo.
+ * @note Os critérios contados em amostras (`PEAK_FALL_SAMPLES`, o atraso de
+ * @ref HEAD_POSITION) passam a valer um tempo menor numa peça com conversões extras.
  * @{
  */
-/** @} */
 
-/** 
- * @defgroup MAIN_LOOP Lógica Principal (loop)
- * @brief Processamento contínuo dos pads e envio de mensagens MIDI.
- * @details Este grupo descreve o fluxo principal do firmware que roda no Arduino:
- * - Lê continuamente os sensores piezoelétricos;
- * - Aplica máquinas de estado para cada pad;
- * - Gerencia crosstalk, repiques e choke;
- * - Lida com o pedal do chimbal e envia as notas MIDI correspondentes.
- * 
- * Engloba a função `loop()` e os subgrupos de processamento (`PAD_SIMPLES` e `PAD_DUAL_ZONE`).
- * @{
+/** @brief Conversões por varredura: os sensores e, se contínuo, o pedal do chimbal. */
+#define SCAN_CHANNELS (NUM_PADS + PEDAL_CHIMBAL_ANALOG)
+#define SCAN_PEDAL_CHANNEL NUM_PADS /**< Canal da varredura ocupado pelo pedal contínuo. */
+
+#define SCAN_SAMPLE_RATE_MAX_HZ  10000UL  /**< Taxa máxima de amostragem por sensor (Hz). */
+#define SCAN_CONVERSION_RATE_MAX 110000UL /**< Conversões por segundo que a varredura sustenta (ADC a 2 MHz). */
+
+/**
+ * @brief Taxa de amostragem por sensor (em Hz).
+ * @details A taxa total de conversões do ADC é `SCAN_SAMPLE_RATE_HZ * SCAN_CHANNELS`, limitada
+ * a `SCAN_CONVERSION_RATE_MAX`. Com até 11 sensores cada um é lido a 10 kHz; acima disso
+ * a taxa cai na proporção (~3,4 kHz com 32 sensores, ~2,3 kHz com 48). Isso ainda cabe
+ * numa janela de pico de 2 ms com margem, já que todas as janelas são medidas em µs e
+ * não em amostras.
+ * @note Acima de ~1 MHz de clock do ADC a resolução efetiva cai para cerca de 8 bits, o
+ * que ainda é suficiente para o mapeamento de velocidade.
  */
-/** @} */
+const unsigned long SCAN_SAMPLE_RATE_HZ = min(SCAN_SAMPLE_RATE_MAX_HZ, SCAN_CONVERSION_RATE_MAX / SCAN_CHANNELS);
 
 /**
- * @defgroup LOOP_PADS_DUAL_ZONE Processamento dos Pads Dual-Zone
- * @ingroup MAIN_LOOP
- * @brief Loop para a detecção e processamento de pads com duas zonas (Caixa, Condução, Ataque).
- * @details Estes pads são processados em pares (principal e secundário) e
- * possuem lógicas complexas para diferenciar entre as zonas de toque (ex: pele/aro, borda/cúpula)
- * e funcionalidades avançadas como Rimshot e Choke.
- * A máquina de estados é similar aos pads simples, mas adaptada para dois sensores,
- * e inclui o estado `PAD_STATE_CHOKE_CONFIRMATION` para pratos.
- * @{
+ * @brief Número de amostras guardadas por pad no buffer circular (potência de 2).
+ * @details Reduzido com muitos sensores para caber na SRAM de 2,5 KB do ATmega32U4.
  */
-/** @} */
+#if NUM_PADS > 24
+#define SCAN_BUFFER_LEN 4
+#else
+#define SCAN_BUFFER_LEN 8
+#endif
 
-/** @ingroup INICIALIZACAO */
-void setup() {
-  Serial.begin(31250); // Taxa de bauds padrão para comunicação MIDI via Serial
+/** @brief Últimas amostras de cada pad, escritas pela interrupção do ADC. */
+volatile uint16_t scanBuffer[NUM_PADS][SCAN_BUFFER_LEN];
+/** @brief Posição de escrita do buffer circular de cada pad. */
+volatile uint8_t scanHead[NUM_PADS];
+/** @brief Maior amostra de cada pad desde a última chamada a scanTake(). */
+volatile uint16_t scanPeak[NUM_PADS];
+/** @brief Número de amostras novas de cada pad desde a última chamada a scanTake() (satura em 255). */
+volatile uint8_t scanFresh[NUM_PADS];
+/** @brief Número de amostras consumidas por cada pad na última chamada a scanTake(). */
+uint8_t scanTakenCount[NUM_PADS];
+/** @brief Posição de `scanHead[]` de cada pad na última chamada a scanTake(). */
+uint8_t scanTakenHead[NUM_PADS];
+/** @brief Canal da varredura cuja conversão está em andamento. */
+volatile uint8_t scanCurrentPad = 0;
 
-  for (int i = 0; i < NUM_PADS; i++) {
-    pinMode(piezoPin[i], INPUT);
-    padState[i] = PAD_STATE_IDLE;
-    stateChangeTime[i] = 0;
-    peakFoundTime[i] = 0;
-    retriggerThresholdInitialDecay[i] = 0;
-  }
+/** @brief Valor de `ADMUX` pré-calculado para cada canal da varredura. */
+uint8_t scanAdmux[SCAN_CHANNELS];
+/** @brief Valor de `ADCSRB` pré-calculado para cada canal da varredura (bit MUX5 e fonte de disparo). */
+uint8_t scanAdcsrb[SCAN_CHANNELS];
 
-  pinMode(PEDAL_CHIMBAL_PIN, INPUT_PULLUP);
+#if SCAN_SCHEDULING
+/** @brief Uso de um canal na agenda da varredura (scanScheduleSet()). */
+enum ScanClass {
+  SCAN_CLASS_NORMAL, /**< Uma conversão por passagem: a taxa mínima garantida. */
+  SCAN_CLASS_BOOST,  /**< Uma conversão por passagem mais as liberadas pelos canais fora da agenda. */
+  SCAN_CLASS_SKIP    /**< Fora da agenda: a leitura seria descartada. */
+};
+
+/** @brief Agendas da varredura: a em uso pela interrupção e a próxima, montada pelo `loop()`. */
+uint8_t scanSchedule[2][SCAN_CHANNELS];
+/** @brief Índice da agenda em uso em `scanSchedule[]`. */
+volatile uint8_t scanScheduleActive = 0;
+/** @brief Indica que a outra agenda está pronta e entra em uso na próxima passagem. */
+volatile bool scanSchedulePending = false;
+/** @brief Posição da próxima conversão na agenda em uso. */
+uint8_t scanSlot;
+/** @brief Canal da conversão anterior à atual, cujo resultado está no registrador `ADC`. */
+uint8_t scanPreviousPad;
+/** @brief Uso de cada canal na última agenda montada (@ref ScanClass). */
+uint8_t scanClass[SCAN_CHANNELS];
+
+/**
+ * @brief Canal da próxima conversão; chamada pela interrupção e pelo simulador.
+ * @details Troca para a agenda pendente só no início de uma passagem, para que cada
+ * passagem siga uma agenda inteira.
+ */
+inline uint8_t scanScheduleNext() {
+  uint8_t slot = scanSlot;
+  if (slot == 0 && scanSchedulePending) {
+    scanScheduleActive ^= 1;
+    scanSchedulePending = false;
+  }
+  uint8_t channel = scanSchedule[scanScheduleActive][slot];
+  scanSlot = (slot + 1 == SCAN_CHANNELS) ? 0 : slot + 1;
+  return channel;
 }
 
-/** @ingroup MAIN_LOOP */
-void loop() {
-  unsigned long currentMillis = millis();
-  /** @brief O Chimbal possui lógica especial para sons aberto/fechado com base no pedal. */
-  // --- Processamento do Pedal do Chimbal (Digital) ---
-  int currentPedalReading = digitalRead(PEDAL_CHIMBAL_PIN); // Lê o estado do pedal do chimbal
-  if (currentPedalReading != lastPedalChimbalState) {
-    lastPedalChimbalState = currentPedalReading;
-    if (currentPedalReading == LOW) { // Pedal pressionado (Fechado)
-      if (chimbalOpenSoundPlaying) {
-        midiNoteOff(MIDI_NOTE_CHIMBAL_OPEN, 0); // Envia nota MIDI para pedal pressionado
-      }
-      midiNoteOn(MIDI_NOTE_CHIMBAL_PEDAL, 30);
-    } else { // Pedal Solto (Aberto)
-      if (chimbalClosedSoundPlaying) {
-        midiNoteOff(MIDI_NOTE_CHIMBAL_CLOSED, 0); // Envia nota MIDI para pedal solto
-      }
+/**
+ * @brief Monta a próxima agenda da varredura.
+ * @details Cada canal fora de `SCAN_CLASS_SKIP` ocupa uma posição. As posições livres vão
+ * para os canais `SCAN_CLASS_BOOST` (sem nenhum, para todos os canais), em rodízio e
+ * intercaladas por igual na passagem, para que as amostras extras fiquem espaçadas no
+ * tempo. Um canal que volta à agenda tem o pico retido zerado: até a primeira amostra
+ * nova, scanTake() devolve 0, e não uma leitura de antes do salto.
+ * @param cls Uso de cada canal da varredura (@ref ScanClass).
+ * @return `false` se a agenda anterior ainda não entrou em uso (tentar de novo depois).
+ */
+bool scanScheduleSet(const uint8_t *cls) {
+  if (scanSchedulePending) return false;
+  uint8_t base[SCAN_CHANNELS], extra[SCAN_CHANNELS];
+  uint8_t bases = 0, extras = 0;
+  for (uint8_t c = 0; c < SCAN_CHANNELS; c++) {
+    if (cls[c] != SCAN_CLASS_SKIP) base[bases++] = c;
+    if (cls[c] == SCAN_CLASS_BOOST) extra[extras++] = c;
+  }
+  if (bases == 0) return true; // Todos em debounce: mantém a agenda atual
+  if (extras == 0) {
+    memcpy(extra, base, bases);
+    extras = bases;
+  }
+
+  uint8_t *schedule = scanSchedule[scanScheduleActive ^ 1];
+  uint8_t n = 0, k = 0, spare = SCAN_CHANNELS - bases, error = 0;
+  for (uint8_t b = 0; b < bases; b++) {
+    schedule[n++] = base[b];
+    for (error += spare; error >= bases; error -= bases) { // Bresenham: `spare` extras em `bases` passos
+      schedule[n++] = extra[k];
+      if (++k == extras) k = 0;
     }
   }
-  pedalChimbalState = currentPedalReading; // Atualiza o último estado do pedal
-
-  /**
-   * @defgroup LOOP_PADS_SIMPLES Processamento dos Pads Simples
-   * @ingroup MAIN_LOOP
-   * @brief Loop para a detecção e processamento de pads com uma única zona.
-   * @details Cada pad simples passa por uma máquina de estados para garantir detecção precisa.
-   * Veja a seguir os estados detalhados:
-   *
-   * @subsection PAD_STATE_IDLE_SIMPLE Estado Ocioso (PAD_STATE_IDLE) para Pads Simples
-   * @details Aguarda o início de um toque. Se a leitura do sensor ultrapassar o `threshold`,
-   * o pad transiciona para `PAD_STATE_PEAK_DETECTION` para capturar a intensidade máxima da batida.
-   *
-   * @subsection PAD_STATE_PEAK_DETECTION_SIMPLE Estado de Detecção de Pico (PAD_STATE_PEAK_DETECTION) para Pads Simples
-   * @details Encontra a intensidade máxima do toque. O pad permanece neste estado por `PEAK_DETECTION_WINDOW_MS` (7ms),
-   * registrando o valor mais alto lido do sensor.
-   * - Se o pico validado for menor ou igual ao `threshold`, o pad retorna a `IDLE` (falso positivo).
-   * - Caso contrário, calcula a velocidade MIDI, aplica a lógica de eliminação de crosstalk
-   * e envia a nota MIDI correspondente. Transiciona para `PAD_STATE_SILENT_DEBOUNCE`.
-   *
-   * @subsubsection PAD_SIMPLE_CROSSTALK Lógica de Eliminação de Crosstalk para Pads Simples
-   * @details Ignora batidas de baixa velocidade que ocorrem dentro de `CROSSTALK_WINDOW_MS`
-   * após uma batida forte em outro pad, prevenindo disparos indesejados por vibração.
-   *
-   * @subsubsection PAD_SIMPLE_MIDI_OUTPUT Envio de Nota MIDI para Pads Simples
-   * @details Se não for crosstalk, a nota MIDI é disparada.
-   * Possui lógica especial para o Chimbal (aberto/fechado) baseada no pedal.
-   *
-   * @subsection PAD_STATE_SILENT_DEBOUNCE_SIMPLE Estado de Debounce Silencioso (PAD_STATE_SILENT_DEBOUNCE) para Pads Simples
-   * @details Ignora ruídos residuais. O pad permanece neste estado por `SILENT_DEBOUNCE_MS` (20ms),
-   * prevenindo múltiplos disparos de uma única batida. Após o tempo, transiciona
-   * para `PAD_STATE_REPIQUE_CHECK`.
-   *
-   * @subsection PAD_STATE_REPIQUE_CHECK_SIMPLE Estado de Verificação de Repique (PAD_STATE_REPIQUE_CHECK) para Pads Simples
-   * @details Permite batidas rápidas. Durante `REPIQUE_CHECK_MS` (60ms), o limiar de detecção
-   * (`currentRetriggerThreshold`) decai de um valor mais alto (`retriggerThresholdInitialDecay`)
-   * para o `threshold` normal. Isso permite que batidas rápidas sejam detectadas com precisão,
-   * enquanto ruídos residuais menores são ignorados.
-   *
-   * @subsection PAD_STATE_CHOKE_CONFIRMATION_SIMPLE Estado Choke (PAD_STATE_CHOKE_CONFIRMATION) para Pads Simples
-   * @details Não aplicável em pads simples. Este estado não é utilizado no processamento de pads simples
-   * e, se alcançado, o pad retorna diretamente ao estado IDLE.
-   */
-  for (int j = 0; j <= CHIMBAL_PAD; j++) {
-    int currentSensorReading = analogRead(piezoPin[j]); // Sempre lê o sensor
-    unsigned long currentMillis = millis(); // Atualiza o tempo
-
-    switch (padState[j]) {
-      case PAD_STATE_IDLE:
-        if (currentSensorReading > threshold[j]) {
-          peakSensorValues[j] = currentSensorReading;
-          peakFoundTime[j] = currentMillis;
-          padState[j] = PAD_STATE_PEAK_DETECTION;
-          stateChangeTime[j] = currentMillis;
-        }
-        break;
 
-      case PAD_STATE_PEAK_DETECTION:
-        if (currentMillis - stateChangeTime[j] < PEAK_DETECTION_WINDOW_MS) {
-          if (currentSensorReading > peakSensorValues[j]) {
-            peakSensorValues[j] = currentSensorReading;
-            peakFoundTime[j] = currentMillis;
-          }
-        } else {
-          if (peakSensorValues[j] > threshold[j]) {
-            int sensorValueAdjusted = round(peakSensorValues[j] * gainFactor[j]);
-            int velocity = map(sensorValueAdjusted, threshold[j], 1023, minVelocity, maxVelocity);
-            velocity = constrain(velocity, minVelocity, maxVelocity);
-
-            if (velocity < LOW_VELOCITY_DISCARD_THRESHOLD && (currentMillis - lastHighVelocityMidiTime < CROSSTALK_WINDOW_MS)) {
-              padState[j] = PAD_STATE_IDLE;
-            } else {
-              if (j == CHIMBAL_PAD) {
-                if (pedalChimbalState == LOW) {
-                  midiNoteOn(MIDI_NOTE_CHIMBAL_CLOSED, velocity);
-                  if (chimbalOpenSoundPlaying) midiNoteOff(MIDI_NOTE_CHIMBAL_OPEN, 0);
-                } else {
-                  midiNoteOn(MIDI_NOTE_CHIMBAL_OPEN, velocity);
-                  if (chimbalClosedSoundPlaying) midiNoteOff(MIDI_NOTE_CHIMBAL_CLOSED, 0);
-                }
-              } else {
-                midiNoteOn(midiNote[j], velocity);
-              }
-
-              if (velocity > HIGH_VELOCITY_THRESHOLD && midiNote[j] > 36) {
-                lastHighVelocityMidiTime = currentMillis;
-              }
-
-              padState[j] = PAD_STATE_SILENT_DEBOUNCE;
-              stateChangeTime[j] = currentMillis;
-
-              retriggerThresholdInitialDecay[j] = max((int)(threshold[j] * RETRIGGER_MIN_MULTIPLIER),
-                  min(retriggerThreshold[j], peakSensorValues[j] * RETRIGGER_MIN_MULTIPLIER));
-            }
-          } else {
-            padState[j] = PAD_STATE_IDLE;
-          }
-        }
-        break;
+  HAL_ATOMIC_BEGIN();
+  for (uint8_t c = 0; c < NUM_PADS; c++) {
+    if (scanClass[c] == SCAN_CLASS_SKIP && cls[c] != SCAN_CLASS_SKIP) {
+      scanPeak[c] = 0;
+      scanFresh[c] = 0;
+    }
+  }
+  scanSchedulePending = true;
+  HAL_ATOMIC_END();
+  memcpy(scanClass, cls, sizeof(scanClass));
+  return true;
+}
+#endif
 
-      case PAD_STATE_SILENT_DEBOUNCE:
-        if (currentMillis - stateChangeTime[j] >= SILENT_DEBOUNCE_MS) {
-          padState[j] = PAD_STATE_REPIQUE_CHECK;
-          stateChangeTime[j] = currentMillis;
-        }
-        break;
+#if PEDAL_CHIMBAL_ANALOG
+#define PEDAL_FILTER_SHIFT 5 /**< Filtro do pedal: média exponencial de 1/32 (~3,5 ms a 9 kHz). */
+/** @brief Leitura filtrada do pedal contínuo, em ponto fixo (`<< PEDAL_FILTER_SHIFT`). */
+volatile uint16_t scanPedalFiltered = 0;
+#endif
 
-      case PAD_STATE_REPIQUE_CHECK:
-        unsigned long elapsedTime = currentMillis - stateChangeTime[j];
-        if (elapsedTime >= REPIQUE_CHECK_MS) {
-          padState[j] = PAD_STATE_IDLE;
-        } else {
-          long currentRetriggerThreshold = map(elapsedTime, 0, REPIQUE_CHECK_MS,
-              retriggerThresholdInitialDecay[j], threshold[j]);
-          currentRetriggerThreshold = max((long)(threshold[j] * RETRIGGER_MIN_MULTIPLIER),
-              currentRetriggerThreshold);
-
-          if (currentSensorReading > currentRetriggerThreshold) {
-            peakSensorValues[j] = currentSensorReading;
-            peakFoundTime[j] = currentMillis;
-            padState[j] = PAD_STATE_PEAK_DETECTION;
-            stateChangeTime[j] = currentMillis;
-          }
-        }
-        break;
+#if SCAN_MUX_COUNT > 0
+/** @brief Canal dos multiplexadores (S3-S0) a selecionar para cada canal da varredura, ou `MUX_CHANNELS` se a entrada é direta. */
+uint8_t scanMuxChannel[SCAN_CHANNELS];
+/** @brief Canal selecionado atualmente nos multiplexadores. */
+uint8_t scanMuxCurrent;
+/** @brief Registrador `PORTx` de cada pino de seleção. */
+volatile uint8_t *scanMuxPort[4];
+/** @brief Máscara de bit de cada pino de seleção no seu `PORTx`. */
+uint8_t scanMuxMask[4];
 
-      case PAD_STATE_CHOKE_CONFIRMATION:
-        padState[j] = PAD_STATE_IDLE;
-        break;
+/**
+ * @brief Coloca um canal nas linhas de seleção S0-S3 (escrita direta na porta).
+ * @param channel Canal 0-15; `MUX_CHANNELS` mantém a seleção atual.
+ */
+inline void scanMuxSelect(uint8_t channel) {
+  if (channel == MUX_CHANNELS || channel == scanMuxCurrent) return;
+  for (uint8_t bit = 0; bit < 4; bit++) {
+    if (channel & (1 << bit)) *scanMuxPort[bit] |= scanMuxMask[bit];
+    else *scanMuxPort[bit] &= ~scanMuxMask[bit];
+  }
+  scanMuxCurrent = channel;
+}
+#endif
+
+/**
+ * @brief Converte um pino analógico (A0, A1, ...) no canal do multiplexador do ADC.
+ * @param pin Pino analógico do Arduino.
+ * @return Canal do ADC (0-13 no ATmega32U4).
+ */
+uint8_t scanChannelOf(uint8_t pin) {
+  if (pin >= A0) pin -= A0;
+#if defined(analogPinToChannel)
+  pin = analogPinToChannel(pin);
+#endif
+  return pin;
+}
+
+/**
+ * @brief Entrada analógica lida num canal da varredura.
+ * @param channel Índice do pad (@ref PAD_INDICES) ou `SCAN_PEDAL_CHANNEL`.
+ * @return Pino de `piezoPin[]`, ou `PEDAL_CHIMBAL_ANALOG_PIN`.
+ */
+int scanPinOf(uint8_t channel) {
+#if PEDAL_CHIMBAL_ANALOG
+  if (channel == SCAN_PEDAL_CHANNEL) return PEDAL_CHIMBAL_ANALOG_PIN;
+#endif
+  return piezoPin[channel];
+}
+
+/**
+ * @brief Configura o ADC e o Timer1 e inicia a varredura contínua dos pads.
+ * @details O Timer1 opera em modo CTC sem prescaler; cada "compare match B" dispara
+ * uma conversão e o "compare match C", alguns ciclos de ADC depois, roda a interrupção
+ * da varredura. O prescaler do ADC é o maior possível que ainda comporta a taxa total
+ * de conversões (13,5 ciclos de ADC por conversão, com margem).
+ * @pre `piezoPin[]` (ou as entradas dos multiplexadores) configurado como entrada.
+ */
+void scanBegin() {
+#if SCAN_MUX_COUNT > 0
+  for (uint8_t bit = 0; bit < 4; bit++) {
+    pinMode(muxSelectPin[bit], OUTPUT);
+#if defined(ARDUINO)
+    scanMuxPort[bit] = portOutputRegister(digitalPinToPort(muxSelectPin[bit]));
+    scanMuxMask[bit] = digitalPinToBitMask(muxSelectPin[bit]);
+#endif
+  }
+  for (uint8_t m = 0; m < SCAN_MUX_COUNT; m++) pinMode(muxAdcPin[m], INPUT);
+  scanMuxCurrent = MUX_CHANNELS;
+#endif
+
+  for (uint8_t i = 0; i < SCAN_CHANNELS; i++) {
+    int pin = scanPinOf(i);
+#if SCAN_MUX_COUNT > 0
+    scanMuxChannel[i] = MUX_CHANNELS;
+    if (MUX_IS_INPUT(pin)) {
+      scanMuxChannel[i] = pin & (MUX_CHANNELS - 1);
+      pin = muxAdcPin[(pin >> 4) & 0x07];
     }
+#endif
+#if defined(ARDUINO)
+    uint8_t channel = scanChannelOf(pin);
+    scanAdmux[i] = _BV(REFS0) | (channel & 0x07);                          // Referência AVcc
+    scanAdcsrb[i] = ((channel & 0x08) ? _BV(MUX5) : 0) | _BV(ADTS2) | _BV(ADTS0); // Disparo: Timer1 Compare B
+#else
+    (void)pin;
+#endif
+#if SCAN_SCHEDULING
+    scanSchedule[0][i] = i;
+    scanClass[i] = SCAN_CLASS_NORMAL;
+#endif
+    if (i == SCAN_PEDAL_CHANNEL) continue;
+    scanHead[i] = 0;
+    scanPeak[i] = 0;
+    scanFresh[i] = 0;
   }
-  /** @} */ // Fecha o grupo LOOP_PADS_SIMPLES
 
-  /** @ingroup LOOP_PADS_DUAL_ZONE */
-  for (int j = CAIXA_PAD; j < NUM_PADS; j = j + 2) {
-    int currentSensorPrincipalReading = analogRead(piezoPin[j]);
-    int currentSensorSecundarioReading = analogRead(piezoPin[j+1]);
-    currentMillis = millis(); // Atualiza o tempo
+  scanCurrentPad = 0;
+#if SCAN_SCHEDULING
+  scanScheduleActive = 0;
+  scanSchedulePending = false;
+  scanSlot = (SCAN_CHANNELS > 1) ? 1 : 0; // A conversão do canal 0 começa com o ADMUX abaixo
+  scanPreviousPad = SCAN_CHANNELS - 1;
+#endif
 
-    switch (padState[j]) {
-      case PAD_STATE_IDLE:
-      /**
-       * @brief Estado Ocioso: Aguarda o início de um toque em qualquer zona.
-       * @details Se a leitura de qualquer um dos sensores (principal ou secundário)
-       * ultrapassar seu respectivo `threshold`, o pad transiciona para
-       * `PAD_STATE_PEAK_DETECTION`.
-       */
-        if (currentSensorPrincipalReading > threshold[j] || currentSensorSecundarioReading > threshold[j+1]) {
-          // Detectou um toque inicial, inicia a detecção de pico
-          peakSensorValues[j] = currentSensorPrincipalReading;
-          peakSensorValues[j+1] = currentSensorSecundarioReading;
-          peakFoundTime[j] = currentMillis;
-          padState[j] = PAD_STATE_PEAK_DETECTION;
-          stateChangeTime[j] = currentMillis;
-        }
-        break;
+#if defined(ARDUINO)
+  const unsigned long conversionRate = SCAN_SAMPLE_RATE_HZ * SCAN_CHANNELS;
+  uint8_t prescalerBits = 7; // divisor 128
+  while (prescalerBits > 2 && (F_CPU >> prescalerBits) < conversionRate * 14) {
+    prescalerBits--;
+  }
 
-      case PAD_STATE_PEAK_DETECTION:
-      /**
-       * @brief Estado de Detecção de Pico: Encontra as intensidades máximas de ambas as zonas.
-       * @details O pad permanece neste estado por `PEAK_DETECTION_WINDOW_MS` (7ms),
-       * registrando os valores mais altos de ambos os sensores.
-       * - Se ambos os picos validados estiverem abaixo do `threshold`, retorna a `IDLE`.
-       * - Caso contrário, calcula as velocidades MIDI para ambas as zonas, aplica a lógica
-       * de crosstalk e determina qual som MIDI enviar (pele, aro, cúpula, rimshot, potencial choke).
-       * Transiciona para `PAD_STATE_SILENT_DEBOUNCE` ou `PAD_STATE_CHOKE_CONFIRMATION` (se ativado).
-       */
-        // Continua buscando o pico dentro da janela
-        if (currentMillis - stateChangeTime[j] < PEAK_DETECTION_WINDOW_MS) {
-          if (currentSensorPrincipalReading > peakSensorValues[j]) peakSensorValues[j] = currentSensorPrincipalReading;
-          if (currentSensorSecundarioReading > peakSensorValues[j+1]) peakSensorValues[j+1] = currentSensorSecundarioReading;
-        } else {
-          // Janela de detecção de pico encerrou.
-          if (peakSensorValues[j] <= threshold[j] && peakSensorValues[j+1] <= threshold[j+1]) {
-            padState[j] = PAD_STATE_IDLE;
-          } else {
-            // Sinal validado pela detecção de pico.
-            int velocityPrincipal = constrain(map(round(peakSensorValues[j] * gainFactor[j]), threshold[j], 1023, minVelocity, maxVelocity), minVelocity, maxVelocity);
-            int velocitySecundario = constrain(map(round(peakSensorValues[j+1] * gainFactor[j+1]), threshold[j+1], 1023, minVelocity, maxVelocity), minVelocity, maxVelocity);
-
-            /**
-             * @brief Lógica de Eliminação de Crosstalk para Pads Dual-Zone.
-             * @details Ignora batidas de baixa velocidade (considerando a maior velocidade
-             * entre as duas zonas) que ocorrem dentro da janela de crosstalk.
-             */
-            if (max(velocitySecundario, velocityPrincipal) < LOW_VELOCITY_DISCARD_THRESHOLD && (currentMillis - lastHighVelocityMidiTime < CROSSTALK_WINDOW_MS)) {
-                padState[j] = PAD_STATE_IDLE;
-            } else {
-              /**
-               * @brief Envio de Nota MIDI e Lógica Específica para Pads Dual-Zone.
-               * @details Determina o som a ser emitido (pele, aro, cúpula, rimshot)
-               * com base na comparação das intensidades dos dois sensores.
-               */
-              // *** LÓGICA DE RIMSHOT PARA CAIXA_PAD ***
-              if (j == CAIXA_PAD) {
-                /**
-                 * @brief Lógica de Rimshot para a Caixa.
-                 * @details Ativa o som de Rimshot se ambos os sensores (pele e aro)
-                 * detectarem um golpe forte e simultâneo.
-                 * Caso contrário, diferencia entre som de aro (se o aro for dominante)
-                 * ou som da pele (borda normal).
-                 * @note Os valores de 600 são sugestões para "golpe forte" e podem ser ajustados.
-                 */
-                if (peakSensorValues[CAIXA_PAD] > 600 && peakSensorValues[ARO_CAIXA_PAD] > 2 * threshold[ARO_CAIXA_PAD]) {
-                  midiNoteOn(MIDI_NOTE_RIMSHOT, max(velocityPrincipal, velocitySecundario));
-                } 
-                // Lógica para som de cúpula/aro (se o aro for dominante)
-                else if (peakSensorValues[j] < 1000 && peakSensorValues[j+1] * 1.1 > peakSensorValues[j]) {
-                  midiNoteOn(midiNote[j+1], velocitySecundario); // Toca o aro
-                } 
-                // Lógica para borda normal (golpe principal na pele)
-                else {
-                  midiNoteOn(midiNote[j], velocityPrincipal); // Toca a caixa
-                }
-              } // *** LÓGICA PARA CONDUÇÃO E ATAQUE (COM CHOKE CONFIRMATION) ***
-              else { // Para CONDUCAO_BORDA_PAD e ATAQUE_BORDA_PAD
-                /**
-                 * @brief Lógica de Sons e Potencial Choke para Pratos (Condução e Ataque).
-                 * @details Diferencia entre som de cúpula (se a cúpula for dominante)
-                 * e som de borda.
-                 * Se o sinal da cúpula for muito baixo em relação à borda, indica um potencial choke
-                 * e as notas são desligadas.
-                 * @warning A transição para `PAD_STATE_CHOKE_CONFIRMATION` está desativada no código e requer revisão.
-                 */
-                  if (peakSensorValues[j] < 1000 && peakSensorValues[j+1] > peakSensorValues[j]) { // som de cupula
-                    midiNoteOn(midiNote[j+1], velocitySecundario);
-                  } // Potencial choke (se o secundário for muito fraco em relação ao primário)
-                  else if (peakSensorValues[j+1] < peakSensorValues[j] * 0.05) { // Potencial choke
-                    //padState[j] = PAD_STATE_CHOKE_CONFIRMATION;
-                    /** @todo Corrigir transição para PAD_STATE_CHOKE_CONFIRMATION */
-                    // Mesmo com o bug na transição, tenta desligar as notas imediatamente
-                    midiNoteOff(midiNote[j], 0);
-                    midiNoteOff(midiNote[j+1], 0);
-                    stateChangeTime[j] = currentMillis; // Marca o início do período de (falha de) confirmação
-                  } else { // borda maior (não é choke e não é cúpula)
-                    midiNoteOn(midiNote[j], velocityPrincipal);
-                  }
-              }
-
-              /**
-               * @brief Atualização do tempo da última batida forte para Dual-Zone.
-               * @details Usado na lógica de crosstalk. Considera a maior velocidade entre as zonas.
-               */
-              if (max(velocitySecundario, velocityPrincipal) > HIGH_VELOCITY_THRESHOLD && midiNote[j] > 36) {
-                  lastHighVelocityMidiTime = currentMillis;
-              }
-
-              // Transiciona para o debounce silencioso após disparar a nota
-              // APENAS SE NÃO ENTROU NO CHOKE_CONFIRMATION (para Condução/Ataque, se ativado)
-              if (padState[j] != PAD_STATE_CHOKE_CONFIRMATION) { // Garante que não sobrescreve o estado se já estiver em CHOKE_CONFIRMATION
-                  padState[j] = PAD_STATE_SILENT_DEBOUNCE;
-                  stateChangeTime[j] = currentMillis;
-              }
-
-              // Armazena o valor inicial do retrigger para o decaimento linear
-              retriggerThresholdInitialDecay[j] = max((int)(threshold[j] * RETRIGGER_MIN_MULTIPLIER), min(retriggerThreshold[j], max(peakSensorValues[j], peakSensorValues[j+1]) * RETRIGGER_MIN_MULTIPLIER));
-              retriggerThresholdInitialDecay[j+1] = retriggerThresholdInitialDecay[j]; // Aplica ao secundário também para consistência
-            }
-          }
-        }
-        break;
+  HAL_ATOMIC_BEGIN();
+  ADMUX = scanAdmux[0];
+  ADCSRB = scanAdcsrb[0];
+#if SCAN_MUX_COUNT > 0
+  scanMuxSelect(scanMuxChannel[0]);
+#endif
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | prescalerBits;
 
-      case PAD_STATE_SILENT_DEBOUNCE:
-        /**
-         * @brief Estado de Debounce Silencioso: Ignora ruídos residuais para Dual-Zone.
-         * @details Comportamento similar ao pad simples, garantindo um período de
-         * silêncio após um toque validado antes de checar por repiques.
-         * Transiciona para `PAD_STATE_REPIQUE_CHECK`.
-         */
-        // Verifica se o tempo do debounce silencioso já passou
-        if (currentMillis - stateChangeTime[j] >= SILENT_DEBOUNCE_MS) {
-          // Transiciona para o estado de checagem de repique
-          padState[j] = PAD_STATE_REPIQUE_CHECK;
-          stateChangeTime[j] = currentMillis;
-        }
-        break;
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS10);   // CTC, clock da CPU
+  OCR1A = (F_CPU / conversionRate) - 1;
+  OCR1B = OCR1A;
+  OCR1C = 3 << prescalerBits;        // A amostra é retida 2 ciclos de ADC após o disparo
+  TCNT1 = 0;
+  TIFR1 = _BV(OCF1C) | _BV(OCF1B);
+  TIMSK1 = _BV(OCIE1C);
+  HAL_ATOMIC_END();
+#endif
+}
 
-      case PAD_STATE_REPIQUE_CHECK:
-        /**
-         * @brief Estado de Verificação de Repique: Permite batidas rápidas para Dual-Zone.
-         * @details O `currentRetriggerThreshold` decai linearmente, similar aos pads simples.
-         * No entanto, a detecção de um novo repique considera o maior pico entre os dois sensores.
-         * - Se `max(currentSensorPrincipalReading, currentSensorSecundarioReading)`
-         * ultrapassar o limiar, transiciona para `PAD_STATE_PEAK_DETECTION`.
-         * - Retorna a `IDLE` se o tempo de repique expirar.
-         */
-        unsigned long elapsedTime = currentMillis - stateChangeTime[j];
-        if (elapsedTime >= REPIQUE_CHECK_MS) {
-          padState[j] = PAD_STATE_IDLE;
-        } else {
-          long currentRetriggerThreshold = map(elapsedTime, 0, REPIQUE_CHECK_MS, retriggerThresholdInitialDecay[j], threshold[j]);
-          currentRetriggerThreshold = max((long)(threshold[j] * RETRIGGER_MIN_MULTIPLIER), currentRetriggerThreshold);
-
-          // Se houver repique, o estado muda para peak_detection
-          if (max(currentSensorPrincipalReading, currentSensorSecundarioReading) > currentRetriggerThreshold) {
-            peakSensorValues[j] = currentSensorPrincipalReading;
-            peakSensorValues[j+1] = currentSensorSecundarioReading;
-            peakFoundTime[j] = currentMillis;
-            padState[j] = PAD_STATE_PEAK_DETECTION;
-            stateChangeTime[j] = currentMillis;
-          }
-        }
-        break;
+#if CAPTURE_ENABLED
+extern volatile uint8_t captureState;                // Definidas em @ref CAPTURE
+void captureStore(uint8_t pad, uint16_t sample);
+#endif
 
-       case PAD_STATE_CHOKE_CONFIRMATION:
-        /**
-         * @brief Estado de Confirmação de Choke (Exclusivo para Pratos de Condução e Ataque).
-         * @details Este estado, embora atualmente desativado na transição de `PEAK_DETECTION` (bug),
-         * é projetado para verificar, após um breve período (`CHOKE_CONFIRMATION_TIME_MS`),
-         * se um "choke" (abafamento do prato) realmente ocorreu.
-         * - Continua monitorando os picos dos dois sensores.
-         * - Após o tempo, se o pico do sensor secundário (cúpula) for muito baixo em relação
-         * ao principal (borda) ou em valor absoluto, o choke é confirmado e as notas MIDI são desligadas.
-         * - Caso contrário, o evento é reavaliado como um possível toque normal ou o pad retorna a `IDLE`.
-         */
-        // Certifica-se de que este estado só seja processado para pads de Condução e Ataque
-        if (j == CONDUCAO_BORDA_PAD || j == ATAQUE_BORDA_PAD) {
-          // Continuar buscando o pico dos dois sensores durante o tempo de confirmação
-          if (analogRead(piezoPin[j]) > peakSensorValues[j]) peakSensorValues[j] = analogRead(piezoPin[j]);
-          if (analogRead(piezoPin[j+1]) > peakSensorValues[j+1]) peakSensorValues[j+1] = analogRead(piezoPin[j+1]);
-
-          // Se o tempo de confirmação passou
-          if (currentMillis - stateChangeTime[j] >= CHOKE_CONFIRMATION_TIME_MS) {
-            // Reavalia o estado do sensor secundário usando os picos finais para confirmar o choke
-            // NOTA: peakSensorValues[j] aqui é o pico máximo atingido no primário durante a janela de choke
-            //       peakSensorValues[j+1] aqui é o pico máximo atingido no secundário durante a janela de choke
-            if (peakSensorValues[j+1] < (peakSensorValues[j] * 0.05) || peakSensorValues[j+1] < 20) {
-              // Choke confirmado: Enviar MIDI Note Offs para as notas que estão tocando neste pad
-              if (j == CONDUCAO_BORDA_PAD) {
-                  midiNoteOff(midiNote[CONDUCAO_BORDA_PAD], 0);
-                  midiNoteOff(midiNote[CONDUCAO_CUPULA_PAD], 0);
-              } else if (j == ATAQUE_BORDA_PAD) {
-                  midiNoteOff(midiNote[ATAQUE_BORDA_PAD], 0);
-                  midiNoteOff(midiNote[ATAQUE_CUPULA_PAD], 0);
-              }
-              padState[j] = PAD_STATE_IDLE; // Volta ao IDLE após o choke
-            } else {
-              // Não foi choke ou o secundário se tornou relevante (não houve "choke" claro)
-              // Se houver nova atividade significativa, transiciona para PEAK_DETECTION, senão IDLE.
-              if (peakSensorValues[j] > threshold[j] || peakSensorValues[j+1] > threshold[j+1]) {
-                 padState[j] = PAD_STATE_PEAK_DETECTION; // Volta para detectar o pico real do que aconteceu
-                 stateChangeTime[j] = currentMillis; // Reinicia o tempo para PEAK_DETECTION
-              } else {
-                 padState[j] = PAD_STATE_IDLE; // Volta para IDLE se não houver mais atividade significativa
-              }
-            }
-            // Resetar peakSensorValues para este pad (e seu secundário) para que o próximo ciclo comece do zero
-            peakSensorValues[j] = 0;
-            peakSensorValues[j+1] = 0;
-          }
-          // Se o tempo ainda não passou, permanece neste estado lendo os sensores e atualizando os picos.
-        } else { // Se algum pad que não deveria estar aqui (ex: Caixa) entra neste estado, volta para IDLE
-          padState[j] = PAD_STATE_IDLE;
-          peakSensorValues[j] = 0; // Resetar picos para pad inválido no choke state
-          peakSensorValues[j+1] = 0;
-        }
-        break;
-    }
+/**
+ * @brief Grava uma amostra convertida no buffer e no pico retido do pad.
+ * @details Chamada pela interrupção do ADC no Arduino e pelo simulador no computador,
+ * que injeta as amostras de um traço gravado.
+ * @param pad Índice do pad (@ref PAD_INDICES).
+ * @param sample Valor de 10 bits lido do ADC.
+ */
+void scanStoreSample(uint8_t pad, uint16_t sample) {
+#if CAPTURE_ENABLED
+  if (captureState) captureStore(pad, sample); // Captura em andamento (diferente de CAPTURE_OFF)
+#endif
+  uint8_t head = (scanHead[pad] + 1) & (SCAN_BUFFER_LEN - 1);
+  scanBuffer[pad][head] = sample;
+  scanHead[pad] = head;
+
+  uint8_t fresh = scanFresh[pad];
+  if (fresh == 0 || sample > scanPeak[pad]) scanPeak[pad] = sample;
+  if (fresh != 255) scanFresh[pad] = fresh + 1;
+}
+
+#if PEDAL_CHIMBAL_ANALOG
+/**
+ * @brief Acumula uma amostra do pedal contínuo no filtro passa-baixas.
+ * @details Chamada pela interrupção do ADC no Arduino e pelo simulador no computador.
+ * @param sample Valor de 10 bits lido do ADC.
+ */
+void scanStorePedal(uint16_t sample) {
+  scanPedalFiltered += sample - (scanPedalFiltered >> PEDAL_FILTER_SHIFT);
+}
+
+/** @brief Leitura filtrada do pedal contínuo (0-1023). */
+uint16_t scanPedal() {
+  HAL_ATOMIC_BEGIN();
+  uint16_t filtered = scanPedalFiltered;
+  HAL_ATOMIC_END();
+  return filtered >> PEDAL_FILTER_SHIFT;
+}
+#endif
+
+#if defined(ARDUINO)
+/**
+ * @brief Interrupção da varredura: grava a amostra anterior e seleciona o próximo pad.
+ * @details Roda com a conversão de `scanCurrentPad` em andamento e já retida, então:
+ * - o registrador `ADC` ainda tem o resultado do pad anterior, concluído antes deste disparo;
+ * - `ADMUX`/`ADCSRB` só passam a valer na próxima conversão, e trocar os multiplexadores
+ *   não afeta mais a amostra atual.
+ *
+ * A flag OCF1B precisa ser limpa para rearmar o gatilho. A primeira passagem grava um
+ * zero no último canal, sem efeito. Com `SCAN_SCHEDULING`, o próximo canal vem da agenda
+ * e o anterior é lembrado em `scanPreviousPad`, já que não é mais o vizinho.
+ */
+ISR(TIMER1_COMPC_vect) {
+  uint8_t pad = scanCurrentPad;
+  uint16_t sample = ADC;
+  TIFR1 = _BV(OCF1B);
+
+#if SCAN_SCHEDULING
+  uint8_t next = scanScheduleNext();
+  uint8_t previous = scanPreviousPad;
+  scanPreviousPad = pad;
+#else
+  uint8_t next = pad + 1;
+  if (next == SCAN_CHANNELS) next = 0;
+  uint8_t previous = pad ? pad - 1 : SCAN_CHANNELS - 1;
+#endif
+  ADMUX = scanAdmux[next];
+  ADCSRB = scanAdcsrb[next];
+#if SCAN_MUX_COUNT > 0
+  scanMuxSelect(scanMuxChannel[next]);
+#endif
+  scanCurrentPad = next;
+
+#if PEDAL_CHIMBAL_ANALOG
+  if (previous == SCAN_PEDAL_CHANNEL) {
+    scanStorePedal(sample);
+    return;
   }
-} // Fim do void loop()
+#endif
+  scanStoreSample(previous, sample);
+}
+#endif
 
 /**
- * @brief Envia uma mensagem MIDI Note On pela porta Serial.
- * @param note O número da nota MIDI (0-127).
- * @param velocity A velocidade da nota (0-127).
- * @note Também atualiza as flags globais de estado `...Playing` para o controle de choke.
+ * @brief Consome as amostras de um pad convertidas desde a última chamada.
+ * @param pad Índice do pad (@ref PAD_INDICES).
+ * @return O maior valor amostrado desde a última chamada. Se nenhuma amostra nova
+ * chegou, devolve o mesmo valor da chamada anterior.
  */
-void midiNoteOn(int note, int velocity) {
-  byte channel = 0;
-  Serial.write(0x90 | channel);
-  Serial.write((byte)note);
-  Serial.write((byte)velocity);
+int scanTake(uint8_t pad) {
+  HAL_ATOMIC_BEGIN();
+  uint16_t peak = scanPeak[pad];
+  scanTakenCount[pad] = scanFresh[pad];
+  scanTakenHead[pad] = scanHead[pad];
+  scanFresh[pad] = 0;
+  HAL_ATOMIC_END();
+  return peak;
+}
 
-  // Atualiza flags de notas tocando
-  if (note == midiNote[CONDUCAO_BORDA_PAD]) conducaoBordaPlaying = true;
-  else if (note == midiNote[CONDUCAO_CUPULA_PAD]) conducaoCupulaPlaying = true;
-  else if (note == midiNote[ATAQUE_BORDA_PAD]) ataqueBordaPlaying = true;
-  else if (note == midiNote[ATAQUE_CUPULA_PAD]) ataqueCupulaPlaying = true;
-  else if (note == midiNote[CAIXA_PAD]) caixaPlaying = true;
-  else if (note == midiNote[ARO_CAIXA_PAD]) aroCaixaPlaying = true;
-  else if (note == MIDI_NOTE_CHIMBAL_CLOSED) chimbalClosedSoundPlaying = true;
-  else if (note == MIDI_NOTE_CHIMBAL_OPEN) chimbalOpenSoundPlaying = true;
+/**
+ * @brief Copia, em ordem, as amostras consumidas pela última chamada a scanTake().
+ * @details Deve ser chamada logo depois de scanTake(). Entrega no máximo
+ * `SCAN_BUFFER_LEN - 1` amostras (as mais recentes), para que a interrupção possa gravar
+ * uma amostra nova sem sobrescrever as que estão sendo lidas.
+ * @param pad Índice do pad (@ref PAD_INDICES).
+ * @param out Recebe as amostras, da mais antiga para a mais recente.
+ * @return Número de amostras copiadas.
+ */
+uint8_t scanTakenSamples(uint8_t pad, uint16_t *out) {
+  uint8_t count = min(scanTakenCount[pad], (uint8_t)(SCAN_BUFFER_LEN - 1));
+  uint8_t index = scanTakenHead[pad] - count + 1;
+  for (uint8_t i = 0; i < count; i++, index++) out[i] = scanBuffer[pad][index & (SCAN_BUFFER_LEN - 1)];
+  return count;
+}
+/** @} */
+
+#if PEAK_TRACKING
+/**
+ * @defgroup PEAK_ESTIMATION Estimativa do Pico e Fim Antecipado da Janela
+ * @brief Pico entre amostras e decisão do toque assim que o sinal começa a cair.
+ * @details Com poucas amostras por janela, a maior amostra raramente cai no pico real do
+ * pulso, e a velocidade oscila conforme a fase da amostragem. Em vez de só o máximo, o
+ * motor acompanha cada amostra da janela (scanTakenSamples()) e guarda as vizinhas do
+ * máximo de cada zona. Com `PEAK_ESTIMATOR_PARABOLIC`, o pico é o vértice da parábola
+ * pelas três amostras:
+ * `pico = y0 + (y₋₁ - y₊₁)² / (8·(2·y0 - y₋₁ - y₊₁))`.
+ * O resultado nunca passa de `y0 · 1,25` nem de 1023. Sem vizinhas dos dois lados (máximo
+ * saturado ou ainda recente), vale o próprio máximo.
+ *
+ * Com `PEAK_FALL_SAMPLES` > 0, a janela de pico termina assim que todas as zonas com
+ * sinal (pico acima do `threshold`) tiverem essa quantidade de amostras seguidas em
+ * queda depois do máximo. A janela cheia passa a ser só o limite, o que reduz a latência
+ * média do toque.
+ * @{
+ */
+#define PEAK_NO_SAMPLE 0xFFFF /**< PadRuntime::peakBefore sem amostra anterior ao máximo. */
+
+/** @brief Zera o acompanhamento de todas as zonas de uma peça. */
+void peakTrackBegin(PadRuntime &r) {
+  for (uint8_t z = 0; z < PAD_MAX_ZONES; z++) {
+    r.peak[z] = 0;
+    r.peakBefore[z] = PEAK_NO_SAMPLE;
+    r.peakAfter[z] = 0;
+    r.lastSample[z] = PEAK_NO_SAMPLE;
+    r.sinceMax[z] = 0;
+    r.falling[z] = 0;
+  }
+}
+
+/**
+ * @brief Acompanha as amostras novas de um sensor numa zona.
+ * @pre scanTake() acabou de ser chamada para o sensor.
+ * @param r Estado da peça.
+ * @param z Zona.
+ * @param sensor Sensor da zona (@ref PAD_INDICES).
+ */
+void peakTrackSensor(PadRuntime &r, uint8_t z, uint8_t sensor) {
+  uint16_t samples[SCAN_BUFFER_LEN];
+  uint8_t count = scanTakenSamples(sensor, samples);
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t sample = samples[i];
+    uint16_t last = r.lastSample[z];
+    if (sample > r.peak[z]) {
+      r.peak[z] = sample;
+      r.peakBefore[z] = last;
+      r.sinceMax[z] = 0;
+      r.falling[z] = 0;
+    } else {
+      if (r.sinceMax[z] == 0) r.peakAfter[z] = sample;
+      if (r.sinceMax[z] < 255) r.sinceMax[z]++;
+      if (sample < last) {
+        if (r.falling[z] < 255) r.falling[z]++;
+      } else {
+        r.falling[z] = 0;
+      }
+    }
+    r.lastSample[z] = sample;
+  }
+}
+
+/** @brief Pico estimado de uma zona (@ref PEAK_ESTIMATOR). */
+uint16_t peakEstimate(const PadRuntime &r, uint8_t z) {
+  uint16_t y0 = r.peak[z];
+#if PEAK_ESTIMATOR == PEAK_ESTIMATOR_PARABOLIC
+  if (r.sinceMax[z] == 0 || r.peakBefore[z] == PEAK_NO_SAMPLE || y0 >= 1023) return y0;
+  long d = (long)r.peakBefore[z] - r.peakAfter[z];
+  long c = 2L * y0 - r.peakBefore[z] - r.peakAfter[z];
+  if (c <= 0) return y0;
+  long estimate = y0 + (d * d) / (8 * c);
+  return (uint16_t)min(estimate, min(1023L, (long)y0 + (y0 >> 2)));
+#else
+  (void)z;
+  return y0;
+#endif
+}
+
+/**
+ * @brief Indica se o toque já pode ser decidido antes do fim da janela de pico.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ * @param zones Número de zonas da peça.
+ */
+bool peakSettled(const PadRuntime &r, const PadDescriptor &d, uint8_t zones) {
+#if PEAK_FALL_SAMPLES > 0
+  bool signal = false;
+  for (uint8_t z = 0; z < zones; z++) {
+    if (r.peak[z] <= d.threshold[z]) continue; // Zona sem sinal não segura a decisão
+    if (r.falling[z] < PEAK_FALL_SAMPLES) return false;
+    signal = true;
+  }
+  return signal;
+#else
+  (void)r; (void)d; (void)zones;
+  return false;
+#endif
+}
+/** @} */
+#endif
+
+#if POSITION_SENSING
+/**
+ * @defgroup HEAD_POSITION Posição do Toque na Pele
+ * @brief Estimativa centro/borda dos toques nas peças com `PAD_FLAG_POSITION`.
+ * @details A peça tem um sensor no centro da pele (zona 0) e outro na borda (zona 1,
+ * o aro da caixa). Um toque no centro chega primeiro e mais forte ao sensor do centro;
+ * perto da borda, o sensor da borda recebe o pulso antes e com mais energia. A posição
+ * combina as duas pistas, em partes iguais:
+ * - atraso: amostras entre o máximo do centro e o da borda (PadRuntime::sinceMax),
+ *   convertido para a escala pela janela `POSITION_DELAY_US`;
+ * - intensidade: diferença entre as velocidades das duas zonas, que já descontam limiar
+ *   e ganho de cada sensor.
+ *
+ * O resultado (0 = centro, 127 = borda) sai como `MIDI_CC_POSITION` logo antes do
+ * note-on, no mesmo canal (@ref MIDI_OUTPUT garante a ordem). O cálculo é feito uma vez
+ * por toque, com somas, um produto e deslocamentos; não há divisão em tempo de execução.
+ * @{
+ */
+#define MIDI_CC_POSITION 16 /**< Controlador da posição (General Purpose 1). */
+
+/**
+ * @brief Atraso (em µs) entre o máximo do centro e o da borda num toque no centro.
+ * @details Diferenças maiores saturam em 0 (centro); o atraso oposto satura em 127.
+ * Depende da pele e da montagem dos sensores.
+ */
+#ifndef POSITION_DELAY_US
+#define POSITION_DELAY_US 500
+#endif
+
+/** @brief Amostras por sensor em `POSITION_DELAY_US` (no mínimo 1). */
+const long POSITION_DELAY_SAMPLES = max(1L, (long)(POSITION_DELAY_US * SCAN_SAMPLE_RATE_HZ / 1000000UL));
+/** @brief Passo da escala de posição por amostra de atraso, em Q8. */
+const long POSITION_STEP_Q8 = 64L * 256 / POSITION_DELAY_SAMPLES;
+
+/**
+ * @brief Posição do toque na pele.
+ * @param r Estado da peça ao fim da janela de pico.
+ * @param d Descrição da peça.
+ * @param velocity Velocidade de cada zona.
+ * @return 0 (centro) a 127 (borda).
+ */
+uint8_t headPosition(const PadRuntime &r, const PadDescriptor &d, const int *velocity) {
+  if (r.peak[1] <= d.threshold[1]) return 0; // A borda nem sentiu: centro
+  int lag = (int)r.sinceMax[0] - r.sinceMax[1]; // > 0: a borda chegou depois do centro
+  long delayTerm = 64 - ((lag * POSITION_STEP_Q8) >> 8);
+  long levelTerm = 64 + ((velocity[1] - velocity[0]) >> 1);
+  long position = (delayTerm + levelTerm) >> 1;
+  return (uint8_t)constrain(position, 0L, 127L);
+}
+/** @} */
+#endif
+
+/**
+ * @defgroup NOISE_FLOOR Ruído de Fundo e Limiar Adaptativo
+ * @brief Limiar efetivo de cada sensor ajustado ao ruído medido com a peça em repouso.
+ * @details Vibração do palco e zumbido do amplificador mudam o ruído real ao longo de uma
+ * apresentação. Com `NOISE_TRACKING`, a cada passo em `PAD_STATE_IDLE` sem toque, a
+ * leitura de cada sensor (o máximo desde o passo anterior) alimenta, em ponto fixo Q4:
+ * - uma média móvel exponencial (`noiseEmaQ4[]`, constante `NOISE_EMA_SHIFT`), que
+ *   ignora picos isolados como o vazamento de um toque em outra peça;
+ * - um retentor de pico dessa média (`noiseHoldQ4[]`), que sobe na hora e desce devagar
+ *   (`NOISE_HOLD_SHIFT`), para que um zumbido intermitente não abra brechas.
+ *
+ * O limiar efetivo é `retido * NOISE_MARGIN_Q8 + NOISE_OFFSET`, limitado a
+ * `[threshold * NOISE_MIN_Q8, threshold * NOISE_MAX_Q8]`: num palco silencioso a peça
+ * fica mais sensível que o `threshold` configurado, e com ruído ela sobe só até o teto.
+ * O limiar efetivo substitui o `threshold` no início e na validação do toque e no piso do
+ * retrigger; as tabelas de velocidade continuam partindo do `threshold` configurado, então
+ * a dinâmica do kit não muda.
+ *
+ * As constantes supõem um `loop()` de ~250 µs: a média responde em ~16 ms e o retentor
+ * desce pela metade em ~0,2 s. Por sensor e passo, o custo é de algumas somas e
+ * deslocamentos e três multiplicações.
+ * @{
+ */
+#if NOISE_TRACKING
+#define NOISE_EMA_SHIFT  6   /**< Média: cada leitura pesa 1/64. */
+#define NOISE_HOLD_SHIFT 10  /**< Retentor: desce 1/1024 (e no mínimo 1/16 de leitura) por passo. */
+#define NOISE_MARGIN_Q8  512 /**< Limiar efetivo em relação ao ruído retido (Q8: 2,0). */
+#define NOISE_OFFSET     8   /**< Folga somada ao ruído retido, em leituras do ADC. */
+#define NOISE_MIN_Q8     192 /**< Limiar efetivo mínimo em relação ao `threshold` (Q8: 0,75). */
+#define NOISE_MAX_Q8     640 /**< Limiar efetivo máximo em relação ao `threshold` (Q8: 2,5). */
+
+/** @brief Média do ruído de cada sensor, em Q4. */
+uint16_t noiseEmaQ4[NUM_PADS];
+/** @brief Pico retido da média de cada sensor, em Q4. */
+uint16_t noiseHoldQ4[NUM_PADS];
+/** @brief Limiar efetivo de cada sensor (0 = ainda sem medida: vale o `threshold`). */
+uint16_t noiseThreshold[NUM_PADS];
+
+/** @brief Descarta as medidas de ruído; os limiares voltam aos configurados. */
+void noiseBegin() {
+  memset(noiseEmaQ4, 0, sizeof(noiseEmaQ4));
+  memset(noiseHoldQ4, 0, sizeof(noiseHoldQ4));
+  memset(noiseThreshold, 0, sizeof(noiseThreshold));
+}
+
+/**
+ * @brief Acumula uma leitura em repouso de uma zona e recalcula o seu limiar efetivo.
+ * @param d Descrição da peça.
+ * @param z Zona.
+ * @param reading Maior leitura do sensor desde o passo anterior.
+ */
+void noiseTrack(const PadDescriptor &d, uint8_t z, int reading) {
+  uint8_t sensor = d.sensor[z];
+  int ema = noiseEmaQ4[sensor];
+  ema += ((reading << 4) - ema) >> NOISE_EMA_SHIFT;
+  noiseEmaQ4[sensor] = ema;
+
+  uint16_t hold = noiseHoldQ4[sensor];
+  if ((uint16_t)ema >= hold) hold = ema;
+  else hold -= (hold >> NOISE_HOLD_SHIFT) + 1;
+  noiseHoldQ4[sensor] = hold;
+
+  long level = (((long)hold * NOISE_MARGIN_Q8) >> 12) + NOISE_OFFSET;
+  long low = ((long)d.threshold[z] * NOISE_MIN_Q8) >> 8;
+  long high = ((long)d.threshold[z] * NOISE_MAX_Q8) >> 8;
+  noiseThreshold[sensor] = max(1L, constrain(level, low, high));
+}
+
+/** @brief Limiar efetivo de uma zona. */
+inline int padThreshold(const PadDescriptor &d, uint8_t z) {
+  uint16_t threshold = noiseThreshold[d.sensor[z]];
+  return threshold ? threshold : d.threshold[z];
+}
+#else
+inline void noiseBegin() {}
+inline void noiseTrack(const PadDescriptor &, uint8_t, int) {}
+inline int padThreshold(const PadDescriptor &d, uint8_t z) { return d.threshold[z]; }
+#endif
+/** @} */
+
+/**
+ * @defgroup VELOCITY_LUT Tabelas de Velocidade
+ * @brief Conversão pico → velocidade MIDI por tabela, sem ponto flutuante nem map().
+ * @details Em setup(), cada sensor recebe uma tabela de `VELOCITY_LUT_SIZE` posições gerada
+ * a partir do seu `threshold`, `gainQ8`, da curva escolhida e de `minVelocity`/`maxVelocity`.
+ * A tabela cobre apenas a faixa útil do sensor, do pico em que o sinal com ganho atinge o
+ * `threshold` até o pico em que satura em 1023, com um passo em potência de 2. Assim,
+ * converter um pico custa uma subtração, um deslocamento e uma leitura de tabela.
+ * @note 64 posições por sensor ocupam 704 bytes de SRAM com 11 sensores; uma tabela de
+ * 1024 ou 256 posições por sensor não caberia nos 2,5 KB do ATmega32U4. Com mais de 24
+ * sensores (multiplexadores, @ref SCAN_MUX_COUNT) a tabela cai para 32 posições.
+ * @{
+ */
+#if NUM_PADS > 24
+#define VELOCITY_LUT_BITS 5                        /**< log2 do tamanho da tabela de velocidade. */
+#else
+#define VELOCITY_LUT_BITS 6                        /**< log2 do tamanho da tabela de velocidade. */
+#endif
+#define VELOCITY_LUT_SIZE (1 << VELOCITY_LUT_BITS) /**< Posições da tabela de velocidade de cada sensor. */
+#define VELOCITY_CUSTOM_BITS 6                     /**< log2 do número de pontos de `velocityCurveCustom[]`. */
+
+/**
+ * @brief Forma da curva `VELOCITY_CURVE_CUSTOM` (0 = velocidade mínima, 255 = máxima),
+ * amostrada em `1 << VELOCITY_CUSTOM_BITS` pontos igualmente espaçados.
+ */
+const uint8_t velocityCurveCustom[1 << VELOCITY_CUSTOM_BITS] PROGMEM = {
+    0,   2,   5,   8,  11,  15,  19,  23,  27,  32,  37,  42,  47,  52,  58,  63,
+   69,  75,  80,  86,  92,  98, 104, 110, 116, 122, 128, 133, 139, 145, 150, 156,
+  161, 166, 171, 176, 181, 186, 190, 195, 199, 203, 207, 211, 214, 218, 221, 224,
+  227, 230, 232, 235, 237, 239, 241, 243, 245, 247, 248, 250, 251, 253, 254, 255
+};
+
+/** @brief Tabela de velocidade de cada sensor (também o buffer da @ref CAPTURE, que a regenera ao sair). */
+alignas(uint16_t) uint8_t velocityLut[NUM_PADS][VELOCITY_LUT_SIZE];
+/** @brief Pico correspondente à primeira posição da tabela de cada sensor. */
+int velocityLutBase[NUM_PADS];
+/** @brief Deslocamento que converte `pico - base` em índice da tabela de cada sensor. */
+uint8_t velocityLutShift[NUM_PADS];
+
+/**
+ * @brief Aplica a curva de resposta a uma intensidade normalizada.
+ * @param curve Curva (@ref VelocityCurve).
+ * @param x Intensidade normalizada em Q8 (0 a 256).
+ * @return Intensidade após a curva, em Q8 (0 a 256).
+ */
+uint16_t velocityCurveApply(uint8_t curve, uint16_t x) {
+  switch (curve) {
+    case VELOCITY_CURVE_LOG:    return 2 * x - ((uint32_t)x * x >> 8);
+    case VELOCITY_CURVE_EXP:    return (uint32_t)x * x >> 8;
+    case VELOCITY_CURVE_CUSTOM: return x >= 256 ? 256 : pgm_read_byte(&velocityCurveCustom[x >> (8 - VELOCITY_CUSTOM_BITS)]);
+    default:                    return x;
+  }
+}
+
+/**
+ * @brief Gera a tabela de velocidade de um sensor.
+ * @param sensor Índice do sensor (@ref PAD_INDICES).
+ * @param threshold Limiar do sensor.
+ * @param gainQ8 Ganho do sensor em Q8.
+ * @param curve Curva de resposta (@ref VelocityCurve).
+ */
+void velocityLutBuild(uint8_t sensor, int threshold, uint16_t gainQ8, uint8_t curve) {
+  // Faixa útil em leituras brutas: de (threshold / ganho) até (1023 / ganho)
+  long base = ((long)threshold * 256 + gainQ8 - 1) / gainQ8;
+  long full = min(1023L, (1023L * 256 + gainQ8 - 1) / gainQ8);
+  long range = max(0L, full - base);
+  uint8_t shift = 0;
+  while ((range >> shift) >= VELOCITY_LUT_SIZE - 1) shift++;
+
+  velocityLutBase[sensor] = base;
+  velocityLutShift[sensor] = shift;
+  // x = (adjusted - threshold) * 256 / (1023 - threshold), limitado a 0..256. Como o pico
+  // só cresce, o quociente é acompanhado por somas, sem uma divisão por posição.
+  long span = 1023 - threshold;
+  long x = 0, next = span;
+  for (uint8_t i = 0; i < VELOCITY_LUT_SIZE; i++) {
+    long peak = base + ((long)i << shift) + ((1L << shift) >> 1);
+    long adjusted = (peak * gainQ8 + 128) >> 8;
+    long numerator = (adjusted - threshold) * 256;
+    while (x < 256 && numerator >= next) {
+      x++;
+      next += span;
+    }
+    long y = velocityCurveApply(curve, x);
+    velocityLut[sensor][i] = minVelocity + ((y * (maxVelocity - minVelocity) + 128) >> 8);
+  }
+}
+
+/**
+ * @brief Gera as tabelas de velocidade dos sensores de uma peça.
+ * @param p Índice da peça em `padConfig[]`.
+ */
+void velocityLutBuildPad(uint8_t p) {
+  const PadDescriptor &d = padConfig[p];
+  for (uint8_t z = 0; z < PAD_MAX_ZONES && d.sensor[z] != NO_SENSOR; z++) {
+    velocityLutBuild(d.sensor[z], d.threshold[z], d.gainQ8[z], d.curve);
+  }
+}
+
+/** @brief Gera as tabelas de velocidade de todos os sensores descritos em `padConfig[]`. */
+void velocityLutBegin() {
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) velocityLutBuildPad(p);
+}
+
+/**
+ * @brief Converte o pico de um sensor em velocidade MIDI.
+ * @param sensor Índice do sensor (@ref PAD_INDICES).
+ * @param peak Pico lido no sensor.
+ * @return Velocidade entre `minVelocity` e `maxVelocity`.
+ */
+int velocityLookup(uint8_t sensor, int peak) {
+  int offset = peak - velocityLutBase[sensor];
+  if (offset <= 0) return velocityLut[sensor][0];
+  unsigned int index = (unsigned int)offset >> velocityLutShift[sensor];
+  if (index >= VELOCITY_LUT_SIZE) index = VELOCITY_LUT_SIZE - 1;
+  return velocityLut[sensor][index];
+}
+/** @} */
+
+/**
+ * @defgroup RETRIGGER_DECAY Decaimento do Limiar de Retrigger
+ * @brief Limiar de repique pré-calculado em degraus, sem map() a cada amostra.
+ * @details `padWindows.repiqueCheckUs` é dividido em `RETRIGGER_DECAY_STEPS` degraus. O limiar
+ * atual de cada peça fica em PadRuntime::retriggerLevel e só é recalculado na troca de degrau
+ * (a cada ~11 ms), a partir da forma escolhida em PadDescriptor::decay. Por amostra,
+ * a checagem de repique é apenas uma comparação de tempo e uma de amplitude.
+ * @{
+ */
+#define RETRIGGER_DECAY_STEPS 16 /**< Número de degraus do decaimento. */
+
+/** @brief Duração (em ticks) de cada degrau do decaimento. */
+inline padTick_t retriggerDecayStepTicks() {
+  return PAD_TICKS(padWindows.repiqueCheckUs / RETRIGGER_DECAY_STEPS);
+}
+
+/**
+ * @brief Fração (Q8) do excesso `inicial - threshold` que resta em cada degrau.
+ * Linear: 256·(1 - i/16). Exponencial: 256·e^(-i/4).
+ */
+const uint8_t retriggerDecayShape[2][RETRIGGER_DECAY_STEPS] PROGMEM = {
+  { 255, 240, 224, 208, 192, 176, 160, 144, 128, 112,  96,  80,  64,  48,  32,  16 },
+  { 255, 199, 155, 121,  94,  73,  57,  44,  35,  27,  21,  16,  13,  10,   8,   6 }
+};
+
+/**
+ * @brief Calcula o limiar de retrigger do degrau atual de uma peça.
+ * @details O limiar nunca fica abaixo de `threshold * RETRIGGER_MIN_MULTIPLIER`, com o
+ * limiar efetivo da zona principal (@ref NOISE_FLOOR).
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ */
+void retriggerDecayUpdate(PadRuntime &r, const PadDescriptor &d) {
+  int threshold = padThreshold(d, 0);
+  int floorLevel = (threshold * RETRIGGER_MIN_MULTIPLIER_Q8) >> 8;
+  long excess = (long)r.retriggerInitial - threshold;
+  uint8_t shape = pgm_read_byte(&retriggerDecayShape[d.decay][r.retriggerStep]);
+  int level = threshold + ((excess * shape) >> 8);
+  r.retriggerLevel = max(floorLevel, level);
+}
+
+/**
+ * @brief Inicia o decaimento do limiar ao entrar em `PAD_STATE_REPIQUE_CHECK`.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ */
+void retriggerDecayStart(PadRuntime &r, const PadDescriptor &d) {
+  r.retriggerStep = 0;
+  r.retriggerNextTick = retriggerDecayStepTicks();
+  retriggerDecayUpdate(r, d);
+}
+
+/**
+ * @brief Avança o decaimento de uma peça para o próximo degrau.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ */
+void retriggerDecayAdvance(PadRuntime &r, const PadDescriptor &d) {
+  if (r.retriggerStep < RETRIGGER_DECAY_STEPS - 1) r.retriggerStep++;
+  r.retriggerNextTick += retriggerDecayStepTicks();
+  retriggerDecayUpdate(r, d);
+}
+/** @} */
+
+/**
+ * @defgroup RESIDUAL_ENERGY Energia Residual entre Toques
+ * @brief Desconta do pico de um toque a vibração que sobrou do toque anterior na mesma peça.
+ * @details Num rufo, a pele ainda vibra quando o toque seguinte chega, e o pico lido é a
+ * soma dos dois: as notas saem mais fortes do que foram tocadas. O limiar de retrigger
+ * (@ref RETRIGGER_DECAY) só decide se há um novo toque, sem corrigir a sua intensidade.
+ *
+ * Cada peça guarda em PadRuntime::ringLevel a vibração esperada no instante do último
+ * início de toque. No início do toque seguinte, esse nível decai
+ * exponencialmente com a meia-vida PadDescriptor::ringHalfLifeMs pelo tempo decorrido
+ * (ringResidual()). Ao fim da janela, os picos de todas as zonas são reduzidos na razão
+ * `(pico - residual) / pico` antes da tabela de velocidade (ringKeepQ8()). O toque emitido
+ * passa a ser a nova referência, com o seu pico bruto. São só contas inteiras, com uma
+ * divisão por toque e nenhuma por amostra.
+ *
+ * Só a velocidade muda: a validação, o crosstalk e as regras de zona continuam usando os
+ * picos brutos. Com `ringHalfLifeMs` em 0, nada é descontado; de fábrica, só a caixa tem
+ * uma meia-vida (ver `padTable[]`). A meia-vida de uma peça pode ser medida numa captura bruta (@ref CAPTURE) de um toque isolado: é o
+ * tempo para a envoltória do sinal cair à metade.
+ * @{
+ */
+#define RING_FRACTION_STEPS 16 /**< Subdivisões de cada meia-vida em `ringDecayFraction[]`. */
+#define RING_MAX_HALVES     16 /**< Após tantas meias-vidas, a vibração residual é considerada nula. */
+
+/** @brief Fração (Q8) que resta após `i / 16` de meia-vida: 256·2^(-i/16). */
+const uint8_t ringDecayFraction[RING_FRACTION_STEPS] PROGMEM = {
+  255, 245, 235, 225, 215, 206, 197, 189, 181, 173, 166, 159, 152, 146, 140, 134
+};
+
+/** @brief Duração (em ticks) de uma meia-vida da vibração residual de uma peça. */
+inline padTick_t ringHalfLifeTicks(const PadDescriptor &d) {
+  return PAD_TICKS(d.ringHalfLifeMs * 1000UL);
+}
+
+/**
+ * @brief Vibração residual de um nível após um intervalo.
+ * @param d Descrição da peça.
+ * @param level Nível no início do intervalo.
+ * @param elapsed Duração do intervalo, em ticks.
+ * @return Nível esperado ao fim do intervalo (0 com a correção desligada).
+ */
+uint16_t ringResidual(const PadDescriptor &d, uint16_t level, padTick_t elapsed) {
+  padTick_t half = ringHalfLifeTicks(d);
+  if (level == 0 || half == 0) return 0;
+  uint32_t steps = ((uint32_t)elapsed * RING_FRACTION_STEPS) / half; // Meias-vidas decorridas, em 1/16
+  if (steps >= RING_MAX_HALVES * RING_FRACTION_STEPS) return 0;
+  uint8_t fraction = pgm_read_byte(&ringDecayFraction[steps % RING_FRACTION_STEPS]);
+  return ((uint32_t)(level >> (steps / RING_FRACTION_STEPS)) * fraction) >> 8;
+}
+
+/**
+ * @brief Inicia um toque: decai a vibração residual até o seu início.
+ * @details Chamada antes de PadRuntime::onsetTick receber o novo início.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ * @param now Início do novo toque, em ticks.
+ */
+inline void ringOnset(PadRuntime &r, const PadDescriptor &d, padTick_t now) {
+  r.ringLevel = ringResidual(d, r.ringLevel, PAD_ELAPSED(now, r.onsetTick));
+}
+
+/**
+ * @brief Fração (Q8) do pico que pertence ao toque atual.
+ * @param r Estado da peça.
+ * @param strongestPeak Maior pico bruto entre as zonas do toque.
+ * @return 256 sem vibração residual; menos que isso na proporção do residual.
+ */
+inline uint16_t ringKeepQ8(const PadRuntime &r, int strongestPeak) {
+  if (r.ringLevel == 0 || strongestPeak <= 0) return 256;
+  if (r.ringLevel >= strongestPeak) return 0;
+  return 256 - (uint16_t)(((uint32_t)r.ringLevel << 8) / strongestPeak);
+}
+
+/**
+ * @brief Descarta a referência depois de `RING_MAX_HALVES` meias-vidas sem toque.
+ * @details Chamada com a peça ociosa, antes que a volta dos ticks de 16 bits torne o
+ * último início recente de novo.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ * @param now Instante atual, em ticks.
+ */
+inline void ringExpire(PadRuntime &r, const PadDescriptor &d, padTick_t now) {
+  if (r.ringLevel && PAD_ELAPSED(now, r.onsetTick) >= (padTick_t)(ringHalfLifeTicks(d) * RING_MAX_HALVES)) r.ringLevel = 0;
+}
+/** @} */
+
+/**
+ * @defgroup PROFILING Instrumentação de Desempenho
+ * @brief Contadores de período do `loop()`, amostras por janela de pico, latência e crosstalk.
+ * @details Ativada em tempo de compilação por `PROFILING_ENABLED`. Usa o Timer3 livre,
+ * sem prescaler, como contador de ciclos de CPU de 32 bits (o estouro de 16 bits é
+ * estendido por interrupção). Os contadores são:
+ * - período do `loop()` (mínimo, médio e máximo, em ciclos);
+ * - amostras do sensor principal recebidas em cada janela de detecção de pico, por peça;
+ * - histograma da latência entre o primeiro cruzamento do limiar e a escrita da nota na porta;
+ * - toques descartados como crosstalk, por peça;
+ * - custo de um passo do motor de pads (padEngineStep()), em ciclos, por estado;
+ * - eventos perdidos por estouro das filas de saída.
+ *
+ * Os valores podem ser lidos a qualquer momento por SysEx (@ref SYSEX). Com a
+ * instrumentação desativada, as funções `prof*()` são vazias e somem do binário.
+ * @{
+ */
+#ifndef PROFILING_ENABLED
+#define PROFILING_ENABLED 0 /**< 1 = compila a instrumentação de desempenho. */
+#endif
+
+#define PROF_LATENCY_BINS      16 /**< Número de faixas do histograma de latência. */
+#define PROF_LATENCY_BIN_SHIFT 8  /**< Largura de cada faixa: 2^8 = 256 µs (a última acumula o excedente). */
+#define PROF_STATE_COUNT (PAD_STATE_CHOKE_CONFIRMATION + 1) /**< Número de estados de @ref PadState. */
+
+#if PROFILING_ENABLED
+/** @brief Parte alta (bits 16-31) do contador de ciclos. */
+volatile uint16_t profCycleHigh = 0;
+/** @brief Ciclo de início da passagem anterior do `loop()`. */
+uint32_t profLastLoopStart = 0;
+/** @brief Menor período do `loop()` registrado (em ciclos). */
+uint32_t profLoopMin = 0xFFFFFFFFUL;
+/** @brief Maior período do `loop()` registrado (em ciclos). */
+uint32_t profLoopMax = 0;
+/** @brief Soma dos períodos do `loop()` (em ciclos), para a média. */
+uint32_t profLoopSum = 0;
+/** @brief Número de períodos somados em `profLoopSum`. */
+uint16_t profLoopCount = 0;
+
+/** @brief Amostras acumuladas na janela de pico em andamento de cada peça. */
+uint16_t profPeakSamples[NUM_KIT_PADS];
+/** @brief Menor número de amostras numa janela de pico, por peça. */
+uint16_t profPeakSamplesMin[NUM_KIT_PADS];
+/** @brief Maior número de amostras numa janela de pico, por peça. */
+uint16_t profPeakSamplesMax[NUM_KIT_PADS];
+/** @brief Soma das amostras das janelas de pico, por peça (para a média). */
+uint32_t profPeakSamplesSum[NUM_KIT_PADS];
+/** @brief Número de janelas de pico encerradas, por peça. */
+uint16_t profPeakWindows[NUM_KIT_PADS];
+/** @brief Toques descartados como crosstalk, por peça. */
+uint16_t profCrosstalkDiscards[NUM_KIT_PADS];
+/** @brief Histograma da latência gatilho → transmissão (faixas de 256 µs). */
+uint16_t profLatencyHist[PROF_LATENCY_BINS];
+/** @brief Soma dos ciclos gastos por padEngineStep(), pelo estado em que a peça estava. */
+uint32_t profStateCyclesSum[PROF_STATE_COUNT];
+/** @brief Número de passos somados em `profStateCyclesSum`, por estado. */
+uint16_t profStateSteps[PROF_STATE_COUNT];
+/** @brief Passo mais caro (em ciclos) registrado em cada estado. */
+uint16_t profStateCyclesMax[PROF_STATE_COUNT];
+
+#if defined(ARDUINO)
+/** @brief Estende o Timer3 para 32 bits. */
+ISR(TIMER3_OVF_vect) {
+  profCycleHigh++;
+}
+
+/**
+ * @brief Lê o contador de ciclos de CPU de 32 bits.
+ * @return Ciclos desde profBegin().
+ */
+uint32_t profCycles() {
+  HAL_ATOMIC_BEGIN();
+  uint16_t low = TCNT3;
+  uint16_t high = profCycleHigh;
+  if ((TIFR3 & _BV(TOV3)) && low < 0x8000) high++; // Estouro ainda não atendido
+  HAL_ATOMIC_END();
+  return ((uint32_t)high << 16) | low;
+}
+#else
+/** @brief Contador de ciclos simulado (ver `sim/sim_hal.h`). */
+uint32_t profCycles() {
+  return simCycles();
+}
+#endif
+
+/** @brief Zera todos os contadores de instrumentação. */
+void profReset() {
+  profLoopMin = 0xFFFFFFFFUL;
+  profLoopMax = 0;
+  profLoopSum = 0;
+  profLoopCount = 0;
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    profPeakSamplesMin[p] = 0xFFFF;
+    profPeakSamplesMax[p] = 0;
+    profPeakSamplesSum[p] = 0;
+    profPeakWindows[p] = 0;
+    profCrosstalkDiscards[p] = 0;
+  }
+  for (uint8_t i = 0; i < PROF_LATENCY_BINS; i++) profLatencyHist[i] = 0;
+  for (uint8_t i = 0; i < PROF_STATE_COUNT; i++) {
+    profStateCyclesSum[i] = 0;
+    profStateSteps[i] = 0;
+    profStateCyclesMax[i] = 0;
+  }
+}
+
+/** @brief Inicia o Timer3 como contador de ciclos e zera os contadores. */
+void profBegin() {
+#if defined(ARDUINO)
+  TCCR3A = 0;
+  TCCR3B = _BV(CS30); // Modo normal, clock da CPU
+  TCNT3 = 0;
+  TIMSK3 = _BV(TOIE3);
+#endif
+  profReset();
+  profLastLoopStart = profCycles();
+}
+
+/** @brief Registra o início de uma passagem do `loop()` e o período da anterior. */
+void profLoopStart() {
+  uint32_t start = profCycles();
+  uint32_t period = start - profLastLoopStart;
+  profLastLoopStart = start;
+  if (period < profLoopMin) profLoopMin = period;
+  if (period > profLoopMax) profLoopMax = period;
+  if (profLoopCount == 0xFFFF) { // Mantém a média sem estourar a soma
+    profLoopSum >>= 1;
+    profLoopCount >>= 1;
+  }
+  profLoopSum += period;
+  profLoopCount++;
+}
+
+/**
+ * @brief Acumula amostras recebidas durante a janela de pico de uma peça.
+ * @param p Índice da peça em `padTable[]`.
+ * @param samples Amostras novas do sensor principal nesta passagem.
+ */
+void profPeakSample(uint8_t p, uint8_t samples) {
+  profPeakSamples[p] += samples;
+}
+
+/**
+ * @brief Registra o fim da janela de pico de uma peça.
+ * @param p Índice da peça em `padTable[]`.
+ */
+void profPeakWindowEnd(uint8_t p) {
+  uint16_t samples = profPeakSamples[p];
+  profPeakSamples[p] = 0;
+  if (samples < profPeakSamplesMin[p]) profPeakSamplesMin[p] = samples;
+  if (samples > profPeakSamplesMax[p]) profPeakSamplesMax[p] = samples;
+  profPeakSamplesSum[p] += samples;
+  profPeakWindows[p]++;
+}
+
+/**
+ * @brief Conta um toque descartado como crosstalk.
+ * @param p Índice da peça em `padTable[]`.
+ */
+void profCrosstalk(uint8_t p) {
+  profCrosstalkDiscards[p]++;
+}
+
+/**
+ * @brief Registra a latência entre o gatilho de um toque e a escrita da sua nota.
+ * @param latency Latência na base de tempo ativa (padNow()).
+ */
+void profLatency(padTime_t latency) {
+#if !PAD_TIMING_MICROS
+  latency *= 1000UL;
+#endif
+  uint32_t bin = latency >> PROF_LATENCY_BIN_SHIFT;
+  if (bin >= PROF_LATENCY_BINS) bin = PROF_LATENCY_BINS - 1;
+  profLatencyHist[bin]++;
+}
+
+/**
+ * @brief Marca o início de um passo do motor de pads.
+ * @return Ciclo inicial, a ser repassado a profStepEnd().
+ */
+uint32_t profStepBegin() {
+  return profCycles();
+}
+
+/**
+ * @brief Acumula o custo de um passo do motor de pads.
+ * @param state Estado da peça no início do passo.
+ * @param start Valor devolvido por profStepBegin().
+ */
+void profStepEnd(uint8_t state, uint32_t start) {
+  uint32_t cycles = profCycles() - start;
+  if (cycles > 0xFFFF) cycles = 0xFFFF;
+  if (cycles > profStateCyclesMax[state]) profStateCyclesMax[state] = cycles;
+  if (profStateSteps[state] == 0xFFFF) { // Mantém a média sem estourar a soma
+    profStateCyclesSum[state] >>= 1;
+    profStateSteps[state] >>= 1;
+  }
+  profStateCyclesSum[state] += cycles;
+  profStateSteps[state]++;
+}
+#else
+inline void profBegin() {}
+inline void profLoopStart() {}
+inline void profPeakSample(uint8_t, uint8_t) {}
+inline void profPeakWindowEnd(uint8_t) {}
+inline void profCrosstalk(uint8_t) {}
+inline void profLatency(padTime_t) {}
+inline uint32_t profStepBegin() { return 0; }
+inline void profStepEnd(uint8_t, uint32_t) {}
+#endif
+/** @} */
+
+/**
+ * @defgroup LOOP_BUDGET Orçamento de Tempo do Loop
+ * @brief Limite de duração de cada passagem do `loop()` e modo degradado em sobrecarga.
+ * @details A varredura por interrupção não depende do `loop()`, mas o motor de pads só vê
+ * as amostras a cada passagem: uma passagem longa (rajada de escritas na porta, respostas
+ * SysEx, quadros da cadeia) atrasa o fim das janelas de pico de todas as peças e o envio
+ * das notas. Cada passagem que começa mais de `LOOP_BUDGET_US` após a anterior conta um
+ * estouro e põe o firmware no modo degradado, que tem efeito definido:
+ * - note-offs e CCs esperam na fila enquanto ela estiver abaixo da metade e o mais antigo
+ *   tiver menos de `LOOP_DEFER_MAX_US`; os que precisam sair antes de um note-on
+ *   (midiBeforeNoteOn()) continuam saindo antes dele;
+ * - a posição na pele (@ref HEAD_POSITION) não é enviada e o ruído de fundo
+ *   (@ref NOISE_FLOOR) não é atualizado;
+ * - o motor de pads e os note-ons seguem iguais.
+ *
+ * Após `LOOP_RECOVERY_PASSES` passagens seguidas dentro do orçamento, o modo normal volta.
+ * Os contadores e o estado são lidos por `SYSEX_CMD_LOOP_STATS_QUERY` (@ref SYSEX), com
+ * ou sem @ref PROFILING.
+ * @{
+ */
+const unsigned long LOOP_BUDGET_US    = 1000;  /**< Intervalo máximo entre o início de duas passagens do `loop()`. */
+const unsigned long LOOP_DEFER_MAX_US = 20000; /**< Espera máxima de um note-off ou CC no modo degradado. */
+#define LOOP_RECOVERY_PASSES 64 /**< Passagens seguidas dentro do orçamento para sair do modo degradado. */
+
+padTime_t loopLastStart = 0;       /**< Início da passagem anterior (base de padNow()). */
+padTime_t loopLongestUs = 0;       /**< Maior intervalo entre passagens desde o último reset. */
+uint16_t loopOverruns = 0;         /**< Passagens acima do orçamento (satura em 0xFFFF). */
+uint16_t loopDegradedEntries = 0;  /**< Vezes em que o modo degradado foi ativado. */
+uint8_t loopCleanPasses = 0;       /**< Passagens seguidas dentro do orçamento no modo degradado. */
+bool loopDegraded = false;         /**< Modo degradado ativo. */
+
+/** @brief Marca o início da contagem; chamada ao fim do setup(). */
+inline void loopBudgetBegin() { loopLastStart = padNow(); }
+
+/**
+ * @brief Mede o intervalo desde a passagem anterior e atualiza o modo degradado.
+ * @details Chamada no início de cada passagem do `loop()`.
+ */
+void loopBudgetStart() {
+  padTime_t now = padNow();
+  padTime_t period = now - loopLastStart;
+  loopLastStart = now;
+  if (period > loopLongestUs) loopLongestUs = period;
+  if (period > PAD_TIME(LOOP_BUDGET_US)) {
+    if (loopOverruns != 0xFFFF) loopOverruns++;
+    if (!loopDegraded && loopDegradedEntries != 0xFFFF) loopDegradedEntries++;
+    loopDegraded = true;
+    loopCleanPasses = 0;
+  } else if (loopDegraded && ++loopCleanPasses >= LOOP_RECOVERY_PASSES) {
+    loopDegraded = false;
+  }
+}
+
+/** @brief Zera os contadores (o estado do modo degradado é mantido). */
+void loopBudgetReset() {
+  loopLongestUs = 0;
+  loopOverruns = 0;
+  loopDegradedEntries = 0;
+}
+/** @} */
+
+/**
+ * @defgroup MIDI_OUTPUT Saída MIDI
+ * @brief Filas de eventos entre a varredura dos pads e o estágio de transmissão MIDI.
+ * @details midiNoteOn() e midiNoteOff() não escrevem na porta: apenas empilham um evento
+ * compacto (peça, nota, velocidade, instante) numa fila produtor/consumidor único (SPSC).
+ * Ao fim de cada passagem, midiTransmit() retira das filas somente os eventos que cabem
+ * no buffer de transmissão livre da porta e os envia numa única escrita. Assim, uma porta
+ * lenta (31250 bauds) nunca trava a varredura: os eventos esperam nas filas e, se uma
+ * encher, o evento novo é descartado e contado em `midiOverflowCount`. A fila de note-ons
+ * comporta um toque simultâneo em cada peça, e um note-off recusado fica com a sua voz
+ * para a passagem seguinte (@ref VOICES).
+ *
+ * Na linha DIN cada mensagem ocupa ~1 ms; um flam em várias peças, somado aos note-offs
+ * e ao CC4 do pedal (@ref HIHAT_PEDAL), acumula alguns ms de fila. Por isso há duas
+ * filas (@ref MidiQueue). Os note-ons saem primeiro, pelo instante em que a peça foi
+ * tocada; note-offs e CCs usam a banda que sobra, e CCs repetidos do mesmo controlador
+ * são fundidos no valor mais novo. A ocupação máxima e a maior espera imposta em cada fila
+ * são informadas por `SYSEX_CMD_MIDI_STATS_QUERY` (@ref SYSEX).
+ *
+ * As filas não usam travas: só o produtor escreve `head` e só o consumidor escreve `tail`
+ * (índices de 1 byte, atômicos no AVR). Por isso o consumidor pode ser movido para a
+ * interrupção de transmissão sem mudar o produtor.
+ *
+ * Transportes disponíveis:
+ * - `MIDI_TRANSPORT_SERIAL`: bytes MIDI crus pela Serial (USB CDC, comportamento original);
+ * - `MIDI_TRANSPORT_USB`: pacotes USB-MIDI de 4 bytes pela biblioteca MIDIUSB (Leonardo);
+ * - `MIDI_TRANSPORT_DIN`: MIDI DIN de 5 pinos pela Serial1 a 31250 bauds.
+ *
+ * Nos transportes seriais, `MIDI_RUNNING_STATUS` omite o byte de status quando ele se
+ * repete, economizando 1/3 da banda em rajadas de notas.
+ *
+ * Em kits com mais de uma placa (`CHAIN_ROLE`, @ref CHAIN), a placa secundária não usa o
+ * transporte MIDI para as notas: midiTransmit() envia os mesmos eventos, com o seu
+ * instante de origem, ao mestre pela Serial1, e o mestre os põe nas suas filas.
+ * @{
+ */
+#define MIDI_TRANSPORT_SERIAL 0 /**< Bytes MIDI crus pela Serial. */
+#define MIDI_TRANSPORT_USB    1 /**< USB-MIDI nativo (biblioteca MIDIUSB). */
+#define MIDI_TRANSPORT_DIN    2 /**< MIDI DIN pela Serial1. */
+
+#ifndef MIDI_TRANSPORT
+#define MIDI_TRANSPORT MIDI_TRANSPORT_SERIAL /**< Transporte MIDI em uso. */
+#endif
+
+/** @brief 1 = usa running status nos transportes seriais. */
+#define MIDI_RUNNING_STATUS (MIDI_TRANSPORT == MIDI_TRANSPORT_DIN)
+
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+#include <MIDIUSB.h>
+#elif MIDI_TRANSPORT == MIDI_TRANSPORT_DIN
+#define MIDI_PORT Serial1 /**< Porta serial usada para o MIDI. */
+#else
+#define MIDI_PORT Serial
+#endif
+
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+#define CHAIN_PORT      Serial1   /**< UART que liga as placas (TX de cada uma no RX da outra). */
+#define CHAIN_BAUD      1000000UL /**< Taxa da ligação: exata a 16 MHz, ~10 µs por byte. */
+#define CHAIN_BYTE_US   (10000000UL / CHAIN_BAUD) /**< Duração de um byte na linha (µs). */
+#define CHAIN_FRAME_LEN 8         /**< Bytes de um quadro da ligação. */
+#define CHAIN_TX_BUFFER 64        /**< Buffer de transmissão da Serial1 no núcleo do Arduino. */
+
+/**
+ * @brief Espera (µs) de um note-on local no mestre antes do envio.
+ * @details Um toque da secundária chega ao mestre depois da própria janela de pico, mais
+ * a ligação e uma passagem do `loop()`. Segurar os note-ons locais por esse tempo deixa
+ * um toque remoto anterior sair antes deles. 0 = sem espera.
+ */
+#ifndef CHAIN_MERGE_HOLD_US
+#define CHAIN_MERGE_HOLD_US 500
+#endif
+static_assert(MIDI_TRANSPORT != MIDI_TRANSPORT_DIN, "A ligação entre placas ocupa a Serial1, usada pelo MIDI DIN");
+#endif
+
+#define MIDI_OTHER_CAPACITY 20   /**< Eventos na fila de baixa prioridade: os note-offs de todas as vozes (@ref VOICES) e alguns CCs. */
+#define MIDI_TX_CHUNK       64   /**< Máximo de bytes enviados por passagem (tamanho do endpoint USB). */
+#define MIDI_NO_PAD         0xFF /**< Peça de origem de eventos que não vêm de um pad (ex.: pedal). */
+
+/** @brief Evento MIDI de canal aguardando envio. */
+struct MidiEvent {
+  uint8_t status;   /**< Byte de status (tipo e canal). */
+  uint8_t data1;    /**< Primeiro byte de dados (nota). */
+  uint8_t data2;    /**< Segundo byte de dados (velocidade). */
+  uint8_t pad;      /**< Peça de origem em `padTable[]`, ou `MIDI_NO_PAD`. */
+  padTime_t time;   /**< Instante de origem: cruzamento do limiar do toque, ou padNow() sem peça. */
+  padTick_t queuedTick; /**< Instante em que o evento entrou na fila. */
+};
+
+/** @brief Filas do escalonador de transmissão, em ordem de prioridade. */
+enum MidiQueue {
+  MIDI_QUEUE_NOTE_ON, /**< Note-ons: saem primeiro, pelo instante de origem. */
+  MIDI_QUEUE_OTHER,   /**< Note-offs e CCs: usam a banda que sobra, em ordem de chegada. */
+  MIDI_QUEUE_COUNT
+};
+
+/**
+ * @brief Note-ons que a fila de alta prioridade comporta: um por peça, e também os da
+ * placa secundária no mestre (@ref CHAIN).
+ */
+#if CHAIN_ROLE == CHAIN_ROLE_MASTER
+#define MIDI_NOTE_ON_CAPACITY (2 * NUM_KIT_PADS)
+#else
+#define MIDI_NOTE_ON_CAPACITY NUM_KIT_PADS
+#endif
+
+/** @brief Fila SPSC de eventos: só o produtor escreve `head`, só o consumidor escreve `tail`. */
+struct MidiRing {
+  MidiEvent *event;      /**< Eventos; os publicados vão de `tail` até antes de `head`. */
+  uint8_t size;          /**< Posições de `event[]`: a capacidade mais uma, que fica sempre vazia. */
+  volatile uint8_t head; /**< Próxima posição a ser escrita pelo produtor. */
+  volatile uint8_t tail; /**< Próxima posição a ser lida pelo consumidor. */
+};
+
+MidiEvent midiNoteOnEvents[MIDI_NOTE_ON_CAPACITY + 1]; /**< Posições da fila `MIDI_QUEUE_NOTE_ON`. */
+MidiEvent midiOtherEvents[MIDI_OTHER_CAPACITY + 1];    /**< Posições da fila `MIDI_QUEUE_OTHER`. */
+
+/** @brief Filas entre a varredura (produtor) e a transmissão (consumidor). @see MidiQueue */
+MidiRing midiRing[MIDI_QUEUE_COUNT] = {
+  { midiNoteOnEvents, MIDI_NOTE_ON_CAPACITY + 1, 0, 0 },
+  { midiOtherEvents, MIDI_OTHER_CAPACITY + 1, 0, 0 }
+};
+/** @brief Número de eventos descartados porque a fila estava cheia. */
+volatile uint16_t midiOverflowCount = 0;
+/** @brief Maior ocupação observada de cada fila. */
+uint8_t midiQueueMax[MIDI_QUEUE_COUNT];
+/** @brief Maior espera (µs) de um evento de cada fila entre a chegada e o envio. */
+padTime_t midiDelayMaxUs[MIDI_QUEUE_COUNT];
+/** @brief Número de CCs descartados porque um valor mais novo do mesmo controlador já estava na fila. */
+uint16_t midiMergedCount = 0;
+/** @brief Último byte de status enviado (0 = nenhum), para o running status. */
+uint8_t midiRunningStatus = 0;
+
+bool midiNoteOn(int note, int velocity, uint8_t pad = MIDI_NO_PAD);
+bool midiNoteOff(int note, int velocity, uint8_t pad = MIDI_NO_PAD);
+
+/** @brief Inicializa a porta do transporte MIDI escolhido. */
+void midiBegin() {
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  // O USB-MIDI é configurado pelo núcleo do Arduino.
+#else
+  MIDI_PORT.begin(31250); // Taxa de bauds padrão para comunicação MIDI via Serial
+#endif
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+  CHAIN_PORT.begin(CHAIN_BAUD);
+#endif
+}
+
+/** @brief Posição seguinte a `i` numa fila, com volta ao início. */
+inline uint8_t midiRingNext(const MidiRing &ring, uint8_t i) {
+  return (uint8_t)(i + 1) == ring.size ? 0 : i + 1;
+}
+
+/** @brief Eventos publicados e ainda não enviados de uma fila. */
+inline uint8_t midiQueueDepth(uint8_t queue) {
+  const MidiRing &ring = midiRing[queue];
+  uint8_t head = ring.head, tail = ring.tail;
+  return head >= tail ? head - tail : head + ring.size - tail;
+}
+
+/** @brief Posições livres de uma fila. */
+inline uint8_t midiQueueFree(uint8_t queue) {
+  return midiRing[queue].size - 1 - midiQueueDepth(queue);
+}
+
+/** @brief Indica se há algum evento esperando envio. */
+inline bool midiPending() {
+  for (uint8_t q = 0; q < MIDI_QUEUE_COUNT; q++) {
+    if (midiRing[q].tail != midiRing[q].head) return true;
+  }
+  return false;
+}
+
+/** @brief Zera as estatísticas do escalonador (a contagem de descartes inclusive). */
+void midiStatsReset() {
+  midiOverflowCount = 0;
+  midiMergedCount = 0;
+  memset(midiQueueMax, 0, sizeof(midiQueueMax));
+  memset(midiDelayMaxUs, 0, sizeof(midiDelayMaxUs));
+}
+
+/**
+ * @brief Empilha um evento MIDI com um instante de origem dado, sem nunca bloquear.
+ * @param status Byte de status.
+ * @param data1 Primeiro byte de dados.
+ * @param data2 Segundo byte de dados.
+ * @param pad Peça de origem, ou `MIDI_NO_PAD`.
+ * @param time Instante de origem (padNow()), usado para ordenar os note-ons.
+ * @return `false` se a fila estava cheia e o evento foi descartado.
+ */
+bool midiRingPushAt(uint8_t status, uint8_t data1, uint8_t data2, uint8_t pad, padTime_t time) {
+  uint8_t queue = ((status & 0xF0) == 0x90 && data2 > 0) ? MIDI_QUEUE_NOTE_ON : MIDI_QUEUE_OTHER;
+  MidiRing &ring = midiRing[queue];
+  uint8_t head = ring.head;
+  uint8_t next = midiRingNext(ring, head);
+  if (next == ring.tail) {
+    midiOverflowCount++;
+    return false;
+  }
+  MidiEvent &e = ring.event[head];
+  e.status = status;
+  e.data1 = data1;
+  e.data2 = data2;
+  e.pad = pad;
+  e.time = time;
+  e.queuedTick = PAD_TICK(padNow());
+  ring.head = next; // Publica o evento só depois de preenchido
+  uint8_t depth = midiQueueDepth(queue);
+  if (depth > midiQueueMax[queue]) midiQueueMax[queue] = depth;
+  return true;
+}
+
+/**
+ * @brief Empilha um evento MIDI na fila da sua prioridade, sem nunca bloquear.
+ * @details O instante de origem é o início do toque da peça, ou o atual sem peça.
+ * @param status Byte de status.
+ * @param data1 Primeiro byte de dados.
+ * @param data2 Segundo byte de dados.
+ * @param pad Peça de origem, ou `MIDI_NO_PAD`.
+ * @return `false` se a fila estava cheia e o evento foi descartado.
+ */
+bool midiRingPush(uint8_t status, uint8_t data1, uint8_t data2, uint8_t pad) {
+  return midiRingPushAt(status, data1, data2, pad, (pad != MIDI_NO_PAD) ? padOnsetTime(pad) : padNow());
+}
+
+/**
+ * @brief Põe na frente da fila de note-ons o de instante de origem mais antigo.
+ * @details Peças com janelas de pico diferentes terminam fora da ordem em que foram
+ * tocadas. O consumidor só troca eventos já publicados, então a fila continua SPSC.
+ */
+void midiScheduleEarliest(MidiRing &ring) {
+  uint8_t tail = ring.tail;
+  uint8_t best = tail;
+  for (uint8_t i = midiRingNext(ring, tail); i != ring.head; i = midiRingNext(ring, i)) {
+    if ((long)(ring.event[i].time - ring.event[best].time) < 0) best = i;
+  }
+  if (best == tail) return;
+  MidiEvent earliest = ring.event[best];
+  ring.event[best] = ring.event[tail];
+  ring.event[tail] = earliest;
+}
+
+/**
+ * @brief Indica se algum evento da fila de baixa prioridade precisa sair antes de um note-on.
+ * @details São eles:
+ * - um note-off da mesma nota: é anterior ao note-on e, depois dele, desligaria a nota
+ *   recém-tocada;
+ * - um CC do mesmo toque (mesma peça de origem), como a posição do pedal ou da pele, que
+ *   o instrumento precisa receber antes da nota.
+ */
+bool midiBeforeNoteOn(const MidiEvent &noteOn) {
+  const MidiRing &low = midiRing[MIDI_QUEUE_OTHER];
+  for (uint8_t i = low.tail; i != low.head; i = midiRingNext(low, i)) {
+    const MidiEvent &e = low.event[i];
+    if ((e.status & 0x0F) != (noteOn.status & 0x0F)) continue;
+    if ((e.status & 0xF0) == 0xB0 ? (e.pad == noteOn.pad && e.pad != MIDI_NO_PAD) : e.data1 == noteOn.data1) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Indica se o CC na frente da fila de baixa prioridade tem um valor mais novo atrás dele.
+ * @details Só CCs contínuos (sem peça de origem) são fundidos; o de um toque vale para a
+ * sua nota e sempre sai.
+ */
+bool midiSuperseded(const MidiRing &low) {
+  const MidiEvent &e = low.event[low.tail];
+  if ((e.status & 0xF0) != 0xB0 || e.pad != MIDI_NO_PAD) return false;
+  for (uint8_t i = midiRingNext(low, low.tail); i != low.head; i = midiRingNext(low, i)) {
+    if (low.event[i].status == e.status && low.event[i].data1 == e.data1) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Indica se a fila de baixa prioridade espera nesta passagem (modo degradado, @ref LOOP_BUDGET).
+ * @details Sai assim mesmo se a fila passou da metade ou se o evento da frente já
+ * esperou `LOOP_DEFER_MAX_US`.
+ */
+inline bool midiLowDeferred(const MidiRing &low, padTime_t now) {
+  return loopDegraded && midiQueueDepth(MIDI_QUEUE_OTHER) < MIDI_OTHER_CAPACITY / 2 &&
+         PAD_ELAPSED(PAD_TICK(now), low.event[low.tail].queuedTick) < PAD_TICKS(LOOP_DEFER_MAX_US);
+}
+
+#if CHAIN_ROLE == CHAIN_ROLE_SLAVE
+uint8_t chainEncode(uint8_t *frame, const MidiEvent &e, padTime_t now, uint8_t backlog); // Definida em @ref CHAIN
+#elif CHAIN_ROLE == CHAIN_ROLE_MASTER
+/** @brief Indica se um note-on local ainda espera por toques da secundária (`CHAIN_MERGE_HOLD_US`). */
+inline bool midiHeldForChain(const MidiEvent &e, padTime_t now) {
+  return e.pad < NUM_KIT_PADS && PAD_ELAPSED(PAD_TICK(now), e.queuedTick) < PAD_TICKS(CHAIN_MERGE_HOLD_US);
+}
+#endif
+
+bool sysexReplyStarted(); // Definida em @ref SYSEX
+
+/**
+ * @brief Estágio de transmissão: envia os eventos pendentes que cabem na porta.
+ * @details Codifica os eventos num buffer local e faz uma única escrita. Para antes de
+ * exceder o espaço livre de transmissão, deixando o restante nas filas para a próxima
+ * passagem, de modo que a escrita nunca bloqueia. A cada evento, escolhe:
+ * - o note-on de instante de origem mais antigo, se houver;
+ * - antes dele, os eventos de baixa prioridade até um note-off da mesma nota ou um CC
+ *   do mesmo toque (midiBeforeNoteOn());
+ * - sem note-ons, o próximo note-off ou CC. Um CC com valor mais novo na fila é
+ *   descartado (`midiMergedCount`).
+ *
+ * No mestre de uma cadeia (@ref CHAIN), um note-on local só sai após `CHAIN_MERGE_HOLD_US`
+ * na fila; enquanto isso, a banda vai para a fila de baixa prioridade.
+ *
+ * No modo degradado (@ref LOOP_BUDGET), note-offs e CCs sem note-on à frente esperam
+ * (midiLowDeferred()).
+ *
+ * Durante o envio de uma resposta SysEx (@ref SYSEX), os eventos esperam o F7.
+ * @param flush true = ignora a espera do modo degradado (ex.: antes de uma resposta SysEx).
+ */
+void midiTransmit(bool flush = false) {
+  if (!midiPending() || sysexReplyStarted()) return;
+
+#if CHAIN_ROLE == CHAIN_ROLE_SLAVE
+  int space = min(CHAIN_PORT.availableForWrite(), MIDI_TX_CHUNK);
+  uint8_t backlog = CHAIN_TX_BUFFER - space; // Bytes ainda na fila da UART, à frente destes
+#elif MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  int space = MIDI_TX_CHUNK;
+#else
+  int space = min(MIDI_PORT.availableForWrite(), MIDI_TX_CHUNK);
+#endif
+
+  uint8_t buffer[MIDI_TX_CHUNK];
+  uint8_t length = 0;
+  padTime_t now = padNow();
+  MidiRing &high = midiRing[MIDI_QUEUE_NOTE_ON];
+  MidiRing &low = midiRing[MIDI_QUEUE_OTHER];
+  for (;;) {
+    uint8_t queue;
+    bool noteOn = high.tail != high.head;
+    if (noteOn) {
+      midiScheduleEarliest(high);
+#if CHAIN_ROLE == CHAIN_ROLE_MASTER
+      noteOn = !midiHeldForChain(high.event[high.tail], now);
+#endif
+    }
+    if (noteOn) {
+      queue = midiBeforeNoteOn(high.event[high.tail]) ? MIDI_QUEUE_OTHER : MIDI_QUEUE_NOTE_ON;
+    } else if (low.tail != low.head && (flush || !midiLowDeferred(low, now))) {
+      queue = MIDI_QUEUE_OTHER;
+    } else {
+      break;
+    }
+    MidiRing &ring = midiRing[queue];
+    uint8_t next = midiRingNext(ring, ring.tail);
+    if (queue == MIDI_QUEUE_OTHER && midiSuperseded(ring)) {
+      midiMergedCount++;
+      ring.tail = next;
+      continue;
+    }
+    const MidiEvent &e = ring.event[ring.tail];
+#if CHAIN_ROLE == CHAIN_ROLE_SLAVE
+    if (length + CHAIN_FRAME_LEN > space) break;
+    length += chainEncode(&buffer[length], e, now, backlog + length);
+#else
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+    if (length + 4 > space) break;
+    buffer[length++] = e.status >> 4; // Cabo 0, Code Index Number = tipo da mensagem
+    buffer[length++] = e.status;
+#else
+    bool sendStatus = !MIDI_RUNNING_STATUS || e.status != midiRunningStatus;
+    if (length + (sendStatus ? 3 : 2) > space) break;
+    if (sendStatus) {
+      buffer[length++] = e.status;
+      midiRunningStatus = e.status;
+    }
+#endif
+    buffer[length++] = e.data1;
+    buffer[length++] = e.data2;
+#endif
+    if (queue == MIDI_QUEUE_NOTE_ON && e.pad != MIDI_NO_PAD) profLatency(now - e.time);
+    padTime_t delay = (padTime_t)PAD_ELAPSED(PAD_TICK(now), e.queuedTick) << PAD_TICK_SHIFT;
+    if (delay > midiDelayMaxUs[queue]) midiDelayMaxUs[queue] = delay;
+    ring.tail = next; // Libera a posição consumida para o produtor
+  }
+  if (length == 0) return;
+
+#if CHAIN_ROLE == CHAIN_ROLE_SLAVE
+  CHAIN_PORT.write(buffer, length);
+#elif MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  MidiUSB.write(buffer, length);
+  MidiUSB.flush();
+#else
+  MIDI_PORT.write(buffer, length);
+#endif
+}
+/** @} */
+
+/**
+ * @defgroup VOICES Vozes e Note-Off Agendado
+ * @brief Tabela das notas soando e envio automático dos note-offs.
+ * @details Cada note-on ocupa uma de `VOICE_COUNT` vozes, com o instante em que a nota
+ * deve ser desligada (PadDescriptor::gateMs após o note-on). As vozes ativas ficam num
+ * min-heap ordenado por esse instante. voiceService() só olha a raiz a cada passagem do
+ * `loop()`, e inserir ou remover uma voz custa O(log VOICE_COUNT). `voiceOfNote[]` dá a
+ * voz de cada nota do mapa de percussão GM (`VOICE_NOTE_FIRST` a `VOICE_NOTE_LAST`, onde
+ * ficam todas as notas do kit) em O(1), com 47 bytes em vez de 128. Uma nota de fora do
+ * mapa, só possível por SysEx, é procurada entre as vozes ativas.
+ *
+ * Uma nota repetida enquanto soa só tem o note-off adiado. Se todas as vozes estiverem
+ * ocupadas, a que seria desligada primeiro é desligada na hora para dar lugar à nova.
+ * Peças com `gateMs` 0 não ocupam vozes e nunca recebem note-off automático.
+ *
+ * Uma voz só é liberada depois que o seu note-off entrou na fila de saída (@ref MIDI_OUTPUT).
+ * Com a fila cheia, a voz continua no heap e voiceService() tenta de novo na passagem
+ * seguinte; um note-on que não cabe na fila não ocupa voz. Assim nenhuma nota fica presa
+ * e nenhum note-off sai sem o seu note-on. A fila de baixa prioridade comporta os
+ * note-offs de todas as vozes (`MIDI_OTHER_CAPACITY`).
+ *
+ * `voiceHeap[]` é uma permutação de todas as vozes: as `voiceHeapSize` primeiras
+ * posições formam o heap e as demais são as vozes livres.
+ * @{
+ */
+#define VOICE_COUNT           16   /**< Número de notas acompanhadas ao mesmo tempo. */
+#define VOICE_NONE            0xFF /**< `voiceOfNote[]`: nota sem voz. */
+#define VOICE_NOTE_FIRST      35   /**< Primeira nota de `voiceOfNote[]` (bumbo acústico, início do mapa GM). */
+#define VOICE_NOTE_LAST       81   /**< Última nota de `voiceOfNote[]` (triângulo aberto, fim do mapa GM). */
+#define VOICE_GATE_DEFAULT_MS 100  /**< Gate das notas sem peça de origem (ex.: pedal do chimbal). */
+#define VOICE_GATE_MAX_MS     2000 /**< Maior gate aceito; mantém os instantes do heap a menos de meia volta de `padTick_t`. */
+static_assert(MIDI_OTHER_CAPACITY >= VOICE_COUNT, "A fila de baixa prioridade deve comportar os note-offs de todas as vozes");
+
+/** @brief Nota soando. */
+struct Voice {
+  uint8_t note;      /**< Nota MIDI. */
+  uint8_t pad;       /**< Peça de origem, ou `MIDI_NO_PAD`. */
+  padTick_t offTick; /**< Instante do note-off agendado. */
+};
+
+Voice voices[VOICE_COUNT];          /**< Tabela de vozes. */
+uint8_t voiceOfNote[VOICE_NOTE_LAST - VOICE_NOTE_FIRST + 1]; /**< Voz de cada nota do mapa GM, ou `VOICE_NONE`. */
+uint8_t voiceHeap[VOICE_COUNT];     /**< Heap das vozes ativas, seguido das livres. */
+uint8_t voiceHeapPos[VOICE_COUNT];  /**< Posição de cada voz em `voiceHeap[]`. */
+uint8_t voiceHeapSize = 0;          /**< Número de vozes ativas. */
+
+/** @brief Indica se a voz `a` deve ser desligada antes da voz `b`. */
+inline bool voiceBefore(uint8_t a, uint8_t b) {
+  return (int16_t)(voices[a].offTick - voices[b].offTick) < 0;
+}
+
+/** @brief Troca duas posições do heap. */
+inline void voiceSwap(uint8_t i, uint8_t j) {
+  uint8_t a = voiceHeap[i], b = voiceHeap[j];
+  voiceHeap[i] = b;
+  voiceHeap[j] = a;
+  voiceHeapPos[b] = i;
+  voiceHeapPos[a] = j;
+}
+
+/** @brief Restaura o heap a partir da posição `i`, subindo ou descendo. */
+void voiceSift(uint8_t i) {
+  while (i > 0 && voiceBefore(voiceHeap[i], voiceHeap[(i - 1) / 2])) {
+    voiceSwap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  for (;;) {
+    uint8_t first = i, left = 2 * i + 1, right = left + 1;
+    if (left < voiceHeapSize && voiceBefore(voiceHeap[left], voiceHeap[first])) first = left;
+    if (right < voiceHeapSize && voiceBefore(voiceHeap[right], voiceHeap[first])) first = right;
+    if (first == i) break;
+    voiceSwap(i, first);
+    i = first;
+  }
+}
+
+/** @brief Indica se uma nota tem posição em `voiceOfNote[]`. */
+inline bool voiceIndexed(uint8_t note) {
+  return note >= VOICE_NOTE_FIRST && note <= VOICE_NOTE_LAST;
+}
+
+/**
+ * @brief Voz de uma nota.
+ * @param note Nota MIDI (0 a 127).
+ * @return Índice em `voices[]`, ou `VOICE_NONE` se a nota não estiver soando.
+ */
+uint8_t voiceFind(uint8_t note) {
+  if (voiceIndexed(note)) return voiceOfNote[note - VOICE_NOTE_FIRST];
+  for (uint8_t i = 0; i < voiceHeapSize; i++) { // Fora do mapa GM: procura entre as ativas
+    if (voices[voiceHeap[i]].note == note) return voiceHeap[i];
+  }
+  return VOICE_NONE;
+}
+
+/** @brief Esvazia a tabela de vozes. */
+void voiceBegin() {
+  memset(voiceOfNote, VOICE_NONE, sizeof(voiceOfNote));
+  for (uint8_t v = 0; v < VOICE_COUNT; v++) {
+    voiceHeap[v] = v;
+    voiceHeapPos[v] = v;
+  }
+  voiceHeapSize = 0;
+}
+
+/** @brief Indica se uma nota está soando (tem voz). */
+inline bool voicePlaying(uint8_t note) {
+  return voiceFind(note & 0x7F) != VOICE_NONE;
+}
+
+/**
+ * @brief Libera a voz de uma nota, sem enviar nada.
+ * @param note Nota MIDI.
+ */
+void voiceRelease(uint8_t note) {
+  note &= 0x7F;
+  uint8_t v = voiceFind(note);
+  if (v == VOICE_NONE) return;
+  if (voiceIndexed(note)) voiceOfNote[note - VOICE_NOTE_FIRST] = VOICE_NONE;
+  uint8_t i = voiceHeapPos[v];
+  voiceHeapSize--;
+  if (i != voiceHeapSize) {
+    voiceSwap(i, voiceHeapSize);
+    voiceSift(i);
+  }
+}
+
+/**
+ * @brief Registra um note-on e agenda o seu note-off.
+ * @details Chamada antes de o note-on entrar na fila, para que o note-off de uma voz
+ * roubada saia antes dele.
+ * @param note Nota MIDI.
+ * @param pad Peça de origem, ou `MIDI_NO_PAD`.
+ * @return `false` se não havia voz livre e o note-off da voz a roubar não coube na fila;
+ *         nesse caso nada muda e o note-on deve ser descartado.
+ */
+bool voiceStart(uint8_t note, uint8_t pad) {
+  uint16_t gateMs = (pad != MIDI_NO_PAD) ? padConfig[pad].gateMs : VOICE_GATE_DEFAULT_MS;
+  if (gateMs == 0) return true;
+  note &= 0x7F;
+  padTick_t offTick = PAD_TICK(padNow()) + PAD_TICKS(gateMs * 1000UL);
+
+  uint8_t v = voiceFind(note);
+  if (v != VOICE_NONE) { // Nota repetida: só adia o note-off
+    voices[v].offTick = offTick;
+    voices[v].pad = pad;
+    voiceSift(voiceHeapPos[v]);
+    return true;
+  }
+  if (voiceHeapSize == VOICE_COUNT) { // Sem vozes livres: desliga a mais próxima do fim
+    const Voice &oldest = voices[voiceHeap[0]];
+    if (!midiNoteOff(oldest.note, 0, oldest.pad)) return false;
+  }
+  v = voiceHeap[voiceHeapSize];
+  voices[v].note = note;
+  voices[v].pad = pad;
+  voices[v].offTick = offTick;
+  if (voiceIndexed(note)) voiceOfNote[note - VOICE_NOTE_FIRST] = v;
+  voiceSift(voiceHeapSize++);
+  return true;
+}
+
+/**
+ * @brief Envia os note-offs vencidos.
+ * @param now Instante atual (padNow()).
+ */
+void voiceService(padTime_t now) {
+  padTick_t tick = PAD_TICK(now);
+  while (voiceHeapSize && (int16_t)(tick - voices[voiceHeap[0]].offTick) >= 0) {
+    const Voice &due = voices[voiceHeap[0]];
+    if (!midiNoteOff(due.note, 0, due.pad)) break; // Fila cheia: a voz fica para a próxima passagem
+  }
+}
+
+/**
+ * @brief Envia já os note-offs de todas as notas de uma peça que ainda soam.
+ * @param pad Peça de origem em `padTable[]`.
+ * @return `false` se a fila encheu antes; as vozes que sobraram continuam no heap.
+ */
+bool voiceFlushPad(uint8_t pad) {
+  for (uint8_t i = 0; i < voiceHeapSize;) {
+    const Voice &v = voices[voiceHeap[i]];
+    if (v.pad != pad) {
+      i++;
+    } else {
+      if (!midiNoteOff(v.note, 0, pad)) return false;
+      i = 0; // Liberou a voz e reorganizou o heap: recomeça
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Conta as notas de uma peça que ainda soam.
+ * @param pad Peça de origem em `padTable[]`.
+ * @return Vozes ocupadas pela peça (note-offs que voiceFlushPad() precisa enviar).
+ */
+uint8_t voiceCountPad(uint8_t pad) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < voiceHeapSize; i++) {
+    if (voices[voiceHeap[i]].pad == pad) count++;
+  }
+  return count;
+}
+/** @} */
+
+/**
+ * @defgroup CONFIG Configuração em Tempo de Execução
+ * @brief Parâmetros das peças ajustáveis por SysEx e guardados na EEPROM.
+ * @details O motor lê apenas as cópias em RAM (`padConfig[]`, `padWindows`,
+ * `crosstalkMatrix` e `zoneRules[]`), nunca a EEPROM ou a PROGMEM. A EEPROM só é lida no `setup()` e
+ * só é escrita sob comando (`SYSEX_CMD_CONFIG_SAVE`). A imagem gravada começa com um
+ * @ref ConfigHeader versionado e é validada por CRC-16 antes do uso. Se o cabeçalho,
+ * o tamanho, o CRC ou a descrição das peças (tipo e sensores) não baterem com o
+ * firmware, os valores de fábrica são mantidos.
+ *
+ * Os parâmetros são endereçados por peça (@ref PadParam) ou, com a peça
+ * `CONFIG_GLOBAL`, pelas janelas globais (@ref GlobalParam).
+ * @{
+ */
+#define CONFIG_EEPROM_ADDR 0      /**< Endereço do cabeçalho na EEPROM. */
+#define CONFIG_MAGIC       0x4442 /**< Assinatura da imagem ("BD"). */
+#define CONFIG_VERSION     5      /**< Versão do layout gravado; incrementar a cada mudança. */
+#define CONFIG_GLOBAL      0x7F   /**< Índice de peça usado para os parâmetros globais. */
+
+/** @brief Cabeçalho da imagem de configuração na EEPROM. */
+struct ConfigHeader {
+  uint16_t magic;   /**< `CONFIG_MAGIC`. */
+  uint8_t version;  /**< `CONFIG_VERSION`. */
+  uint8_t pads;     /**< `NUM_KIT_PADS` do firmware que gravou. */
+  uint16_t length;  /**< Bytes gravados após o cabeçalho. */
+  uint16_t crc;     /**< CRC-16/CCITT desses bytes. */
+};
+
+/** @brief Parâmetros ajustáveis de cada peça. */
+enum PadParam {
+  PAD_PARAM_THRESHOLD_0,  /**< PadDescriptor::threshold da zona principal. */
+  PAD_PARAM_THRESHOLD_1,  /**< PadDescriptor::threshold da zona secundária. */
+  PAD_PARAM_RETRIGGER,    /**< PadDescriptor::retrigger. */
+  PAD_PARAM_GAIN_0,       /**< PadDescriptor::gainQ8 da zona principal. */
+  PAD_PARAM_GAIN_1,       /**< PadDescriptor::gainQ8 da zona secundária. */
+  PAD_PARAM_CURVE,        /**< PadDescriptor::curve. */
+  PAD_PARAM_DECAY,        /**< PadDescriptor::decay. */
+  PAD_PARAM_NOTE_0,       /**< PadDescriptor::note da zona principal. */
+  PAD_PARAM_NOTE_1,       /**< PadDescriptor::note da zona secundária. */
+  PAD_PARAM_PEAK_WINDOW,  /**< PadDescriptor::peakWindowUs. */
+  PAD_PARAM_GATE,         /**< PadDescriptor::gateMs. */
+  PAD_PARAM_THRESHOLD_2,  /**< PadDescriptor::threshold da terceira zona. */
+  PAD_PARAM_THRESHOLD_3,  /**< PadDescriptor::threshold da quarta zona. */
+  PAD_PARAM_GAIN_2,       /**< PadDescriptor::gainQ8 da terceira zona. */
+  PAD_PARAM_GAIN_3,       /**< PadDescriptor::gainQ8 da quarta zona. */
+  PAD_PARAM_NOTE_2,       /**< PadDescriptor::note da terceira zona. */
+  PAD_PARAM_NOTE_3,       /**< PadDescriptor::note da quarta zona. */
+  PAD_PARAM_RING_HALF_LIFE, /**< PadDescriptor::ringHalfLifeMs. */
+  PAD_PARAM_COUNT
+};
+
+/** @brief Parâmetros globais (peça `CONFIG_GLOBAL`). */
+enum GlobalParam {
+  GLOBAL_PARAM_PEAK_WINDOW,  /**< PadWindows::peakDetectionUs. */
+  GLOBAL_PARAM_DEBOUNCE,     /**< PadWindows::silentDebounceUs. */
+  GLOBAL_PARAM_REPIQUE,      /**< PadWindows::repiqueCheckUs. */
+  GLOBAL_PARAM_CHOKE,        /**< PadWindows::chokeConfirmationUs. */
+  GLOBAL_PARAM_COUNT
+};
+
+#define CONFIG_PADS_ADDR    (CONFIG_EEPROM_ADDR + sizeof(ConfigHeader)) /**< Início de `padConfig[]` na EEPROM. */
+#define CONFIG_WINDOWS_ADDR (CONFIG_PADS_ADDR + sizeof(padConfig))      /**< Início de `padWindows` na EEPROM. */
+#define CONFIG_XTALK_ADDR   (CONFIG_WINDOWS_ADDR + sizeof(padWindows))  /**< Início de `crosstalkMatrix` na EEPROM. */
+#define CONFIG_RULES_ADDR   (CONFIG_XTALK_ADDR + sizeof(crosstalkMatrix)) /**< Início de `zoneRules[]` na EEPROM. */
+#define CONFIG_LENGTH       (sizeof(padConfig) + sizeof(padWindows) + sizeof(crosstalkMatrix) + sizeof(zoneRules)) /**< Bytes após o cabeçalho. */
+
+/**
+ * @brief Acumula um bloco de bytes no CRC-16/CCITT (polinômio 0x1021).
+ * @param crc Valor acumulado (0xFFFF no início).
+ * @param data Bytes a acumular.
+ * @param length Número de bytes.
+ * @return Novo valor do CRC.
+ */
+uint16_t configCrc(uint16_t crc, const void *data, uint16_t length) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (uint16_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)bytes[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+/** @brief Restaura os valores de fábrica nas cópias em RAM. */
+void configDefaults() {
+  memcpy_P(padConfig, padTable, sizeof(padConfig));
+  memcpy_P(crosstalkMatrix, crosstalkDefaults, sizeof(crosstalkMatrix));
+  padWindows = padWindowsDefaults;
+  zoneRulesDefaults();
+}
+
+/**
+ * @brief Indica se a EEPROM tem uma imagem válida, conferida por configLoad() e
+ * configSave() (no `setup()` e sob comando), e não a cada consulta no `loop()`.
+ */
+bool configStoredValid = false;
+
+/**
+ * @brief Indica se a imagem gravada na EEPROM é válida para este firmware.
+ * @details Confere cabeçalho, tamanho, CRC e a descrição das peças (tipo e sensores). Lê a
+ * imagem inteira: não deve ser chamada durante a execução (use `configStoredValid`).
+ */
+bool configImageValid() {
+  ConfigHeader header;
+  eeprom_read_block(&header, (const void *)CONFIG_EEPROM_ADDR, sizeof(header));
+  if (header.magic != CONFIG_MAGIC || header.version != CONFIG_VERSION ||
+      header.pads != NUM_KIT_PADS || header.length != CONFIG_LENGTH) {
+    return false;
+  }
+
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < CONFIG_LENGTH; i++) {
+    uint8_t b = eeprom_read_byte((const uint8_t *)(CONFIG_PADS_ADDR + i));
+    crc = configCrc(crc, &b, 1);
+  }
+  if (crc != header.crc) return false;
+
+  // Tipo e sensores são do firmware: uma imagem gravada para outro kit é descartada
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    PadDescriptor stored, factory;
+    eeprom_read_block(&stored, (const void *)(CONFIG_PADS_ADDR + p * sizeof(PadDescriptor)), sizeof(stored));
+    memcpy_P(&factory, &padTable[p], sizeof(factory));
+    if (stored.kind != factory.kind || memcmp(stored.sensor, factory.sensor, sizeof(stored.sensor))) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Lê a descrição gravada de uma peça (imagem já validada por configImageValid()).
+ * @details Flags e pino de choke vêm sempre do firmware.
+ * @param p Índice da peça.
+ * @param d Destino.
+ */
+void configReadPad(uint8_t p, PadDescriptor &d) {
+  eeprom_read_block(&d, (const void *)(CONFIG_PADS_ADDR + p * sizeof(PadDescriptor)), sizeof(d));
+  d.flags = pgm_read_byte(&padTable[p].flags);
+  d.chokePin = pgm_read_byte(&padTable[p].chokePin);
+}
+
+/**
+ * @brief Carrega a configuração gravada na EEPROM, se for válida.
+ * @return `true` se a imagem foi aceita; caso contrário a RAM não é alterada.
+ */
+bool configLoad() {
+  configStoredValid = configImageValid();
+  if (!configStoredValid) return false;
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) configReadPad(p, padConfig[p]);
+  eeprom_read_block(&padWindows, (const void *)CONFIG_WINDOWS_ADDR, sizeof(padWindows));
+  eeprom_read_block(crosstalkMatrix, (const void *)CONFIG_XTALK_ADDR, sizeof(crosstalkMatrix));
+  eeprom_read_block(zoneRules, (const void *)CONFIG_RULES_ADDR, sizeof(zoneRules));
+  return true;
+}
+
+/**
+ * @brief Grava a configuração em uso na EEPROM.
+ * @details Usa `eeprom_update_block()`, que só reescreve os bytes alterados. O cabeçalho
+ * é gravado por último: uma gravação interrompida deixa um CRC inválido, e o próximo
+ * `setup()` volta aos valores de fábrica em vez de carregar uma imagem pela metade.
+ */
+void configSave() {
+  ConfigHeader header = { CONFIG_MAGIC, CONFIG_VERSION, NUM_KIT_PADS, CONFIG_LENGTH, 0xFFFF };
+  header.crc = configCrc(header.crc, padConfig, sizeof(padConfig));
+  header.crc = configCrc(header.crc, &padWindows, sizeof(padWindows));
+  header.crc = configCrc(header.crc, crosstalkMatrix, sizeof(crosstalkMatrix));
+  header.crc = configCrc(header.crc, zoneRules, sizeof(zoneRules));
+
+  eeprom_update_block(padConfig, (void *)CONFIG_PADS_ADDR, sizeof(padConfig));
+  eeprom_update_block(&padWindows, (void *)CONFIG_WINDOWS_ADDR, sizeof(padWindows));
+  eeprom_update_block(crosstalkMatrix, (void *)CONFIG_XTALK_ADDR, sizeof(crosstalkMatrix));
+  eeprom_update_block(zoneRules, (void *)CONFIG_RULES_ADDR, sizeof(zoneRules));
+  eeprom_update_block(&header, (void *)CONFIG_EEPROM_ADDR, sizeof(header));
+  configStoredValid = true;
+}
+
+/**
+ * @brief Carrega os valores de fábrica e, por cima, a configuração da EEPROM.
+ * @return `true` se a configuração da EEPROM foi carregada.
+ */
+bool configBegin() {
+  configDefaults();
+  return configLoad();
+}
+
+/**
+ * @brief Lê um parâmetro em uso.
+ * @param pad Índice da peça em `padConfig[]`, ou `CONFIG_GLOBAL`.
+ * @param param @ref PadParam ou @ref GlobalParam.
+ * @return Valor atual (0 para parâmetros inexistentes).
+ */
+uint32_t configGetParam(uint8_t pad, uint8_t param) {
+  if (pad == CONFIG_GLOBAL) {
+    switch (param) {
+      case GLOBAL_PARAM_PEAK_WINDOW: return padWindows.peakDetectionUs;
+      case GLOBAL_PARAM_DEBOUNCE:    return padWindows.silentDebounceUs;
+      case GLOBAL_PARAM_REPIQUE:     return padWindows.repiqueCheckUs;
+      case GLOBAL_PARAM_CHOKE:       return padWindows.chokeConfirmationUs;
+    }
+    return 0;
+  }
+  if (pad >= NUM_KIT_PADS) return 0;
+  const PadDescriptor &d = padConfig[pad];
+  switch (param) {
+    case PAD_PARAM_THRESHOLD_0: return d.threshold[0];
+    case PAD_PARAM_THRESHOLD_1: return d.threshold[1];
+    case PAD_PARAM_RETRIGGER:   return d.retrigger;
+    case PAD_PARAM_GAIN_0:      return d.gainQ8[0];
+    case PAD_PARAM_GAIN_1:      return d.gainQ8[1];
+    case PAD_PARAM_CURVE:       return d.curve;
+    case PAD_PARAM_DECAY:       return d.decay;
+    case PAD_PARAM_NOTE_0:      return d.note[0];
+    case PAD_PARAM_NOTE_1:      return d.note[1];
+    case PAD_PARAM_PEAK_WINDOW: return d.peakWindowUs;
+    case PAD_PARAM_GATE:        return d.gateMs;
+    case PAD_PARAM_THRESHOLD_2: return d.threshold[2];
+    case PAD_PARAM_THRESHOLD_3: return d.threshold[3];
+    case PAD_PARAM_GAIN_2:      return d.gainQ8[2];
+    case PAD_PARAM_GAIN_3:      return d.gainQ8[3];
+    case PAD_PARAM_NOTE_2:      return d.note[2];
+    case PAD_PARAM_NOTE_3:      return d.note[3];
+    case PAD_PARAM_RING_HALF_LIFE: return d.ringHalfLifeMs;
+  }
+  return 0;
+}
+
+/**
+ * @brief Altera um parâmetro em uso (só na RAM; a EEPROM é gravada por configSave()).
+ * @details Limiares, ganhos e curva regeneram as tabelas de velocidade da peça.
+ * @param pad Índice da peça em `padConfig[]`, ou `CONFIG_GLOBAL`.
+ * @param param @ref PadParam ou @ref GlobalParam.
+ * @param value Novo valor.
+ * @return `false` se a peça, o parâmetro ou o valor forem inválidos.
+ */
+bool configSetParam(uint8_t pad, uint8_t param, uint32_t value) {
+  if (pad == CONFIG_GLOBAL) {
+    if (value == 0) return false;
+    switch (param) {
+      case GLOBAL_PARAM_PEAK_WINDOW: padWindows.peakDetectionUs = value; return true;
+      case GLOBAL_PARAM_DEBOUNCE:    padWindows.silentDebounceUs = value; return true;
+      case GLOBAL_PARAM_REPIQUE:     padWindows.repiqueCheckUs = value; return true;
+      case GLOBAL_PARAM_CHOKE:       padWindows.chokeConfirmationUs = value; return true;
+    }
+    return false;
+  }
+  if (pad >= NUM_KIT_PADS) return false;
+  PadDescriptor &d = padConfig[pad];
+  switch (param) {
+    case PAD_PARAM_THRESHOLD_0:
+    case PAD_PARAM_THRESHOLD_1:
+      if (value > 1023) return false;
+      d.threshold[param - PAD_PARAM_THRESHOLD_0] = value;
+      break;
+    case PAD_PARAM_THRESHOLD_2:
+    case PAD_PARAM_THRESHOLD_3:
+      if (value > 1023) return false;
+      d.threshold[2 + param - PAD_PARAM_THRESHOLD_2] = value;
+      break;
+    case PAD_PARAM_RETRIGGER:
+      if (value > 1023) return false;
+      d.retrigger = value;
+      break;
+    case PAD_PARAM_GAIN_0:
+    case PAD_PARAM_GAIN_1:
+      if (value == 0 || value > 0xFFFF) return false;
+      d.gainQ8[param - PAD_PARAM_GAIN_0] = value;
+      break;
+    case PAD_PARAM_GAIN_2:
+    case PAD_PARAM_GAIN_3:
+      if (value == 0 || value > 0xFFFF) return false;
+      d.gainQ8[2 + param - PAD_PARAM_GAIN_2] = value;
+      break;
+    case PAD_PARAM_CURVE:
+      if (value > VELOCITY_CURVE_CUSTOM) return false;
+      d.curve = value;
+      break;
+    case PAD_PARAM_DECAY:
+      if (value > RETRIGGER_DECAY_EXP) return false;
+      d.decay = value;
+      break;
+    case PAD_PARAM_NOTE_0:
+    case PAD_PARAM_NOTE_1:
+      if (value > 127) return false;
+      d.note[param - PAD_PARAM_NOTE_0] = value;
+      break;
+    case PAD_PARAM_NOTE_2:
+    case PAD_PARAM_NOTE_3:
+      if (value > 127) return false;
+      d.note[2 + param - PAD_PARAM_NOTE_2] = value;
+      break;
+    case PAD_PARAM_PEAK_WINDOW:
+      if (value > 0xFFFF) return false;
+      d.peakWindowUs = value;
+      break;
+    case PAD_PARAM_GATE:
+      if (value > VOICE_GATE_MAX_MS) return false;
+      d.gateMs = value;
+      break;
+    case PAD_PARAM_RING_HALF_LIFE:
+      if (value > 0xFF) return false;
+      d.ringHalfLifeMs = value;
+      break;
+    default:
+      return false;
+  }
+  bool lut = (param <= PAD_PARAM_CURVE && param != PAD_PARAM_RETRIGGER) ||
+             (param >= PAD_PARAM_THRESHOLD_2 && param <= PAD_PARAM_GAIN_3);
+  if (lut) velocityLutBuildPad(pad);
+  return true;
+}
+/** @} */
+
+/**
+ * @defgroup KIT_PROFILES Perfis de Kit
+ * @brief Conjuntos completos de parâmetros das peças, trocados em uso sem reiniciar.
+ * @details Um perfil é uma tabela inteira de PadDescriptor (notas, limiares, ganhos,
+ * curvas, janelas, gates). Os perfis de fábrica ficam na flash: `KIT_PROFILE_FACTORY`
+ * (`padTable[]`) e `KIT_PROFILE_PERCUSSION` (`padTablePercussion[]`). O perfil
+ * `KIT_PROFILE_USER` é a configuração gravada na EEPROM por `SYSEX_CMD_CONFIG_SAVE`
+ * (@ref CONFIG), disponível quando a imagem é válida. Todos descrevem as mesmas peças
+ * com os mesmos sensores; isso é conferido na compilação para os perfis da flash e no
+ * carregamento para o da EEPROM. Janelas globais, matriz de crosstalk e regras de zona
+ * não mudam com o perfil.
+ *
+ * A troca é pedida por Program Change no canal `KIT_PROGRAM_CHANNEL` (programa = perfil),
+ * pelo pedal em `KIT_FOOTSWITCH_PIN` (próximo perfil) ou por `SYSEX_CMD_KIT_SELECT`
+ * (@ref SYSEX). Ela não para o motor de pads. kitService() troca uma peça por passagem
+ * do `loop()`, entre os passos do motor, e só quando a peça não está no meio de um toque
+ * (detecção de pico ou confirmação de choke) e a fila de baixa prioridade tem espaço para
+ * todos os note-offs dela (@ref MIDI_OUTPUT). Numa passagem, a peça:
+ * - desliga as notas do perfil antigo que ainda soam, pelos note-offs das vozes
+ *   (voiceFlushPad(), @ref VOICES);
+ * - recebe a descrição do novo perfil;
+ * - tem as tabelas de velocidade regeneradas (@ref VELOCITY_LUT).
+ *
+ * Cada toque é processado inteiro com um só perfil, e a troca do kit leva
+ * `NUM_KIT_PADS` passagens (~2 ms). Trocar um bloco inteiro de configuração por ponteiro
+ * exigiria uma segunda cópia de `padConfig[]` e das tabelas de velocidade, ~1 KB a mais
+ * que a SRAM de 2,5 KB do ATmega32U4 não comporta.
+ *
+ * Ajustes feitos por SysEx valem até a próxima troca; para mantê-los, grave-os na
+ * EEPROM e selecione `KIT_PROFILE_USER`.
+ * @{
+ */
+/** @brief Perfis de kit selecionáveis. */
+enum KitProfile {
+  KIT_PROFILE_FACTORY,    /**< Kit de fábrica (`padTable[]`). */
+  KIT_PROFILE_PERCUSSION, /**< Percussão: congas, bongôs, timbal e efeitos (`padTablePercussion[]`). */
+  KIT_PROFILE_USER,       /**< Configuração gravada na EEPROM. */
+  KIT_PROFILE_COUNT
+};
+
+#define KIT_PROGRAM_CHANNEL 0 /**< Canal (0-15) dos Program Changes que trocam de perfil. */
+const unsigned long KIT_FOOTSWITCH_DEBOUNCE_US = 30000; /**< Tempo após uma mudança do pedal em que outras são ignoradas. */
+
+constexpr PadDescriptor padTablePercussion[] PROGMEM = {
+  // kind             flags              sensores (zonas)                                                   threshold          retr.    ganho                                                 curva                  decaimento              resid. notas                                                          janela              choke               gate
+  { PAD_KIND_SIMPLE, 0,                 { BUMBO_PAD,          NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 120,  0, 0, 0 }, 900, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_BUMBO,          0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { SURDO_PAD,          NO_SENSOR,           NO_SENSOR, NO_SENSOR }, {  45,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LOG,    RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_CONGA_GRAVE,    0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { TOM1_PAD,           NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 230,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LOG,    RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_BONGO_AGUDO,    0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_SIMPLE, 0,                 { TOM2_PAD,           NO_SENSOR,           NO_SENSOR, NO_SENSOR }, { 150,  0, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LOG,    RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_BONGO_GRAVE,    0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_HIHAT,  0,                 { CHIMBAL_PAD,        NO_SENSOR,           NO_SENSOR, NO_SENSOR }, {  80,  0, 0, 0 }, 900, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_CHIMBAL_CLOSED, 0,                         0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,             1000 },
+  { PAD_KIND_ZONED,  PAD_FLAG_POSITION, { CAIXA_PAD,          ARO_CAIXA_PAD,       NO_SENSOR, NO_SENSOR }, {  55, 40, 0, 0 }, 550, { GAIN_Q8(1), GAIN_Q8(1),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LOG,    RETRIGGER_DECAY_LINEAR, 15,    { MIDI_NOTE_TIMBAL_AGUDO,   MIDI_NOTE_CLAVES,          0, 0 }, PAD_WINDOW_DEFAULT, NO_PIN,              100 },
+  { PAD_KIND_ZONED,  PAD_FLAG_CHOKE,    { CONDUCAO_BORDA_PAD, CONDUCAO_CUPULA_PAD, NO_SENSOR, NO_SENSOR }, {  35, 35, 0, 0 }, 950, { GAIN_Q8(1), GAIN_Q8(7),   GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_COWBELL,        MIDI_NOTE_AGOGO_AGUDO,     0, 0 }, PAD_WINDOW_DEFAULT, CONDUCAO_CHOKE_PIN,  300 },
+  { PAD_KIND_ZONED,  PAD_FLAG_CHOKE,    { ATAQUE_BORDA_PAD,   ATAQUE_CUPULA_PAD,   NO_SENSOR, NO_SENSOR }, {  35, 35, 0, 0 }, 680, { GAIN_Q8(1), GAIN_Q8(1.2), GAIN_Q8(1), GAIN_Q8(1) }, VELOCITY_CURVE_LINEAR, RETRIGGER_DECAY_LINEAR, 0,     { MIDI_NOTE_PANDEIRO,       MIDI_NOTE_TRIANGULO,       0, 0 }, PAD_WINDOW_DEFAULT, ATAQUE_CHOKE_PIN,   1000 }
+};
+
+/** @brief Indica se duas tabelas descrevem as mesmas `n` peças (tipo, flags, sensores e choke). */
+constexpr bool kitSameStructure(const PadDescriptor *a, const PadDescriptor *b, uint8_t n) {
+  return n == 0 || (a->kind == b->kind && a->flags == b->flags && a->chokePin == b->chokePin &&
+                    a->sensor[0] == b->sensor[0] && a->sensor[1] == b->sensor[1] &&
+                    a->sensor[2] == b->sensor[2] && a->sensor[3] == b->sensor[3] &&
+                    kitSameStructure(a + 1, b + 1, n - 1));
+}
+static_assert(sizeof(padTablePercussion) == sizeof(padTable) && kitSameStructure(padTable, padTablePercussion, NUM_KIT_PADS),
+              "os perfis de kit devem descrever as mesmas peças de padTable[]");
+
+uint8_t kitActive = KIT_PROFILE_FACTORY; /**< Perfil em uso (o pedido, durante uma troca). */
+uint8_t kitNextPad = NUM_KIT_PADS;       /**< Próxima peça a trocar, ou `NUM_KIT_PADS` sem troca em andamento. */
+bool kitFootswitchPressed = false;       /**< Estado aceito do pedal de troca. */
+padTick_t kitFootswitchTick = 0;         /**< Instante da última mudança aceita do pedal. */
+
+/**
+ * @brief Lê a descrição de uma peça num perfil.
+ * @param profile Perfil (@ref KitProfile); `KIT_PROFILE_USER` exige a imagem da EEPROM válida.
+ * @param p Índice da peça.
+ * @param d Destino.
+ */
+void kitReadPad(uint8_t profile, uint8_t p, PadDescriptor &d) {
+  if (profile == KIT_PROFILE_USER) configReadPad(p, d);
+  else memcpy_P(&d, profile == KIT_PROFILE_PERCUSSION ? &padTablePercussion[p] : &padTable[p], sizeof(d));
+}
+
+/**
+ * @brief Registra o perfil carregado inteiro de uma vez (setup() ou SysEx de @ref CONFIG).
+ * @details Cancela uma troca em andamento.
+ */
+void kitLoaded(uint8_t profile) {
+  kitActive = profile;
+  kitNextPad = NUM_KIT_PADS;
+}
+
+/**
+ * @brief Pede a troca para um perfil; as peças são trocadas por kitService().
+ * @details Pedir o perfil em uso o recarrega, descartando os ajustes feitos por SysEx.
+ * @return `false` se o perfil não existe ou, para `KIT_PROFILE_USER`, se a EEPROM não tem
+ * uma imagem válida.
+ */
+bool kitSelect(uint8_t profile) {
+  if (profile >= KIT_PROFILE_COUNT) return false;
+  if (profile == KIT_PROFILE_USER && !configStoredValid) return false;
+  kitActive = profile;
+  kitNextPad = 0;
+  return true;
+}
+
+/** @brief Lê o pedal de troca: cada pressionada seleciona o próximo perfil disponível. */
+void kitFootswitchPoll(padTime_t now) {
+  if (KIT_FOOTSWITCH_PIN == NO_PIN) return;
+  bool pressed = digitalRead(KIT_FOOTSWITCH_PIN) == LOW;
+  padTick_t tick = PAD_TICK(now);
+  if (pressed == kitFootswitchPressed || PAD_ELAPSED(tick, kitFootswitchTick) < PAD_TICKS(KIT_FOOTSWITCH_DEBOUNCE_US)) return;
+  kitFootswitchPressed = pressed;
+  kitFootswitchTick = tick;
+  if (!pressed) return;
+  uint8_t next = kitActive;
+  do {
+    next = (next + 1) % KIT_PROFILE_COUNT;
+  } while (!kitSelect(next) && next != kitActive);
+}
+
+/**
+ * @brief Avança a troca de perfil em andamento: no máximo uma peça por passagem.
+ * @details Chamada a cada passagem do `loop()`, antes do motor de pads.
+ * @param now Instante atual (padNow()).
+ */
+void kitService(padTime_t now) {
+  kitFootswitchPoll(now);
+  if (kitNextPad >= NUM_KIT_PADS) return;
+  uint8_t p = kitNextPad;
+  uint8_t state = padRuntime[p].state;
+  if (state == PAD_STATE_PEAK_DETECTION || state == PAD_STATE_CHOKE_CONFIRMATION) return; // O toque termina com o perfil antigo
+  if (midiQueueFree(MIDI_QUEUE_OTHER) < voiceCountPad(p)) return; // Espera a fila ter espaço para todos os note-offs da peça
+  if (!voiceFlushPad(p)) return;
+  kitReadPad(kitActive, p, padConfig[p]);
+  velocityLutBuildPad(p);
+  kitNextPad++;
+}
+/** @} */
+
+/**
+ * @defgroup SYSEX Protocolo SysEx
+ * @brief Recepção e envio de mensagens SysEx pela mesma porta do MIDI.
+ * @details As mensagens usam o identificador de fabricante 0x7D (uso não comercial):
+ * `F0 7D <comando> <dados...> F7`. sysexPoll() é chamada a cada passagem do `loop()`,
+ * lê os bytes recebidos sem bloquear e despacha a mensagem completa para sysexHandle().
+ * As respostas são raras e sob demanda, e não bloqueiam o `loop()`: sysexHandle() só
+ * registra a resposta (comando e até dois parâmetros) e sysexReplyService() a envia depois
+ * dos eventos pendentes das filas de saída, a cada passagem só o que cabe no espaço livre
+ * da porta. Sem buffer em SRAM, a resposta é remontada a cada passagem e um cursor pula os
+ * bytes já enviados; cada valor sai inteiro numa passagem (no USB-MIDI, em pacotes de 3
+ * bytes). Até o F7, a entrada não é lida e os eventos MIDI, a captura e os picos da
+ * calibração esperam. Valores de 16 e 32 bits viajam em grupos de 7 bits,
+ * do menos para o mais significativo.
+ * @{
+ */
+#define SYSEX_MANUFACTURER_ID 0x7D /**< Identificador de fabricante para uso não comercial. */
+#define SYSEX_MAX_LEN         48   /**< Tamanho máximo de uma mensagem SysEx recebida. */
+
+/** @brief Comandos SysEx reconhecidos pelo firmware. */
+enum SysexCommand {
+  SYSEX_CMD_PROFILE_QUERY = 0x10, /**< Pede os contadores de instrumentação. */
+  SYSEX_CMD_PROFILE_REPLY = 0x11, /**< Resposta com os contadores de instrumentação. */
+  SYSEX_CMD_PROFILE_RESET = 0x12, /**< Zera os contadores de instrumentação. */
+  SYSEX_CMD_MIDI_STATS_QUERY = 0x13, /**< Pede as estatísticas do escalonador da saída MIDI (@ref MIDI_OUTPUT). */
+  SYSEX_CMD_MIDI_STATS_REPLY = 0x14, /**< Resposta: `<descartes> <fundidos> <n> {ocupação, máxima, espera máx. µs (3 grupos)}...`. */
+  SYSEX_CMD_MIDI_STATS_RESET = 0x15, /**< Zera as estatísticas do escalonador. */
+  SYSEX_CMD_LOOP_STATS_QUERY = 0x16, /**< Pede o estado do orçamento do `loop()` (@ref LOOP_BUDGET). */
+  SYSEX_CMD_LOOP_STATS_REPLY = 0x17, /**< Resposta: `<orçamento µs> <estouros> <maior intervalo µs> <entradas no modo degradado>` (3 grupos cada) `<degradado>`. */
+  SYSEX_CMD_LOOP_STATS_RESET = 0x18, /**< Zera os contadores do orçamento. */
+  SYSEX_CMD_CALIBRATION_START = 0x20, /**< Entra no modo de calibração de crosstalk (@ref CALIBRATION). */
+  SYSEX_CMD_CALIBRATION_STOP  = 0x21, /**< Sai do modo de calibração. */
+  SYSEX_CMD_CALIBRATION_PEAKS = 0x22, /**< Picos simultâneos de todos os sensores após um toque. */
+  SYSEX_CMD_XTALK_SET         = 0x23, /**< Grava uma linha da matriz de crosstalk: `<origem> {razão, janela}...`. */
+  SYSEX_CMD_XTALK_QUERY       = 0x24, /**< Pede uma linha da matriz de crosstalk: `<origem>`. */
+  SYSEX_CMD_XTALK_REPLY       = 0x25, /**< Resposta: `<origem> <n> {razão, janela}...`. */
+  SYSEX_CMD_CAPTURE_START     = 0x26, /**< Inicia a captura bruta (@ref CAPTURE): `<modo> <limiar> <pré> <pós> <sensor>...`. */
+  SYSEX_CMD_CAPTURE_STOP      = 0x27, /**< Encerra a captura bruta. */
+  SYSEX_CMD_CONFIG_SET      = 0x30, /**< Altera um parâmetro (@ref CONFIG): `<peça> <parâmetro> <valor (3 grupos)>`. */
+  SYSEX_CMD_CONFIG_QUERY    = 0x31, /**< Pede todos os parâmetros de uma peça: `<peça>`. */
+  SYSEX_CMD_CONFIG_REPLY    = 0x32, /**< Resposta: `<peça> <n> {valor (3 grupos)}...`. */
+  SYSEX_CMD_CONFIG_SAVE     = 0x33, /**< Grava a configuração em uso na EEPROM. */
+  SYSEX_CMD_CONFIG_LOAD     = 0x34, /**< Recarrega a configuração da EEPROM. */
+  SYSEX_CMD_CONFIG_DEFAULTS = 0x35, /**< Volta aos valores de fábrica (na RAM). */
+  SYSEX_CMD_CONFIG_ACK      = 0x36, /**< Resposta a 0x26, 0x30, 0x33-0x35, 0x37 e 0x3A: `<comando> <1 = ok, 0 = recusado>`. */
+  SYSEX_CMD_RULE_SET        = 0x37, /**< Substitui uma regra de zona (@ref ZONE_RULES): `<índice> {campo (2 grupos)}...`. */
+  SYSEX_CMD_RULE_QUERY      = 0x38, /**< Pede uma regra de zona: `<índice>`. */
+  SYSEX_CMD_RULE_REPLY      = 0x39, /**< Resposta: `<índice> <n> {campo (2 grupos)}...`, campos na ordem de ZoneRule. */
+  SYSEX_CMD_KIT_SELECT      = 0x3A, /**< Troca de perfil de kit (@ref KIT_PROFILES): `<perfil>`. */
+  SYSEX_CMD_KIT_QUERY       = 0x3B, /**< Pede o perfil em uso. */
+  SYSEX_CMD_KIT_REPLY       = 0x3C  /**< Resposta: `<perfil> <troca em andamento> <n perfis> <EEPROM válida>`. */
+};
+
+/** @brief Mensagem SysEx em recepção (sem F0/F7). */
+uint8_t sysexBuffer[SYSEX_MAX_LEN];
+/** @brief Bytes recebidos em `sysexBuffer[]`. */
+uint8_t sysexLength = 0;
+/** @brief Indica se há uma mensagem SysEx em recepção. */
+bool sysexReceiving = false;
+/** @brief Indica se o status em vigor é um Program Change de troca de perfil (@ref KIT_PROFILES). */
+bool sysexProgramChange = false;
+
+/**
+ * @brief Resposta SysEx pendente: o comando da resposta, ou 0 se não há.
+ * @details Há uma resposta por vez; enquanto ela não termina, sysexPoll() não lê a entrada.
+ */
+uint8_t sysexReplyCommand = 0;
+/** @brief Parâmetros da resposta pendente (ex.: comando confirmado e resultado). */
+uint8_t sysexReplyArg[2];
+/** @brief Bytes da resposta pendente já enviados (o cursor entre as passagens). */
+uint16_t sysexReplySent = 0;
+/** @brief Bytes da resposta percorridos pela montagem desta passagem. */
+uint16_t sysexReplyOffset;
+/** @brief Bytes que ainda cabem na porta nesta passagem. */
+uint8_t sysexReplyRoom;
+
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+/** @brief Pacote USB-MIDI da resposta em montagem. */
+uint8_t sysexReplyPacket[4];
+/** @brief Bytes da resposta já postos em `sysexReplyPacket[]` (0 a 2). */
+uint8_t sysexReplyFill = 0;
+#endif
+
+/**
+ * @brief Envia um byte da resposta SysEx.
+ * @details No USB-MIDI os bytes são agrupados em pacotes de 3 (CIN 0x4); o último pacote
+ * sai em sysexReplySend().
+ */
+void sysexReplyByte(uint8_t b) {
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  sysexReplyPacket[1 + sysexReplyFill++] = b;
+  if (sysexReplyFill == 3) {
+    sysexReplyPacket[0] = 0x04;
+    MidiUSB.write(sysexReplyPacket, 4);
+    sysexReplyFill = 0;
+  }
+#else
+  MIDI_PORT.write(b);
+#endif
+}
+
+/**
+ * @brief Avança a montagem por um trecho da resposta e diz se ele sai nesta passagem.
+ * @details Um trecho sai inteiro e em ordem: só se for o primeiro ainda não enviado e
+ * couber no espaço restante. Os anteriores já saíram; os seguintes ficam para a próxima
+ * passagem.
+ * @param length Bytes do trecho.
+ * @return `true` se o trecho deve ser escrito agora.
+ */
+bool sysexReplyFits(uint8_t length) {
+  bool fits = sysexReplyOffset == sysexReplySent && length <= sysexReplyRoom;
+  sysexReplyOffset += length;
+  if (fits) {
+    sysexReplySent += length;
+    sysexReplyRoom -= length;
+  }
+  return fits;
+}
+
+/** @brief Inicia a resposta: F0, identificador de fabricante e comando. */
+void sysexReplyBegin() {
+  if (!sysexReplyFits(3)) return;
+  sysexReplyByte(0xF0);
+  sysexReplyByte(SYSEX_MANUFACTURER_ID);
+  sysexReplyByte(sysexReplyCommand);
+}
+
+/**
+ * @brief Acrescenta um valor à resposta em grupos de 7 bits.
+ * @param value Valor a acrescentar.
+ * @param septets Número de grupos de 7 bits (3 para 16 bits, 5 para 32 bits).
+ */
+void sysexReplyPut(uint32_t value, uint8_t septets) {
+  if (!sysexReplyFits(septets)) return;
+  for (uint8_t i = 0; i < septets; i++) {
+    sysexReplyByte(value & 0x7F);
+    value >>= 7;
+  }
+}
+
+/**
+ * @brief Encerra a resposta SysEx com F7 e libera a porta.
+ * @details No USB-MIDI o último pacote usa CIN 0x5, 0x6 ou 0x7 conforme o número de bytes
+ * que restam com o F7.
+ */
+void sysexReplySend() {
+  if (!sysexReplyFits(1)) return;
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  sysexReplyPacket[1 + sysexReplyFill++] = 0xF7;
+  sysexReplyPacket[0] = 0x04 + sysexReplyFill; // 0x5, 0x6 ou 0x7: fim da SysEx
+  while (sysexReplyFill < 3) sysexReplyPacket[1 + sysexReplyFill++] = 0;
+  MidiUSB.write(sysexReplyPacket, 4);
+  sysexReplyFill = 0;
+#else
+  MIDI_PORT.write((uint8_t)0xF7);
+#endif
+  sysexReplyCommand = 0; // Resposta completa
+}
+
+/**
+ * @brief Pede uma resposta SysEx; ela sai aos poucos por sysexReplyService().
+ * @param command Comando da resposta.
+ * @param arg0 Primeiro parâmetro (comando confirmado, peça, regra ou origem).
+ * @param arg1 Segundo parâmetro (resultado da confirmação).
+ */
+void sysexReplyStart(uint8_t command, uint8_t arg0 = 0, uint8_t arg1 = 0) {
+  sysexReplyCommand = command;
+  sysexReplyArg[0] = arg0;
+  sysexReplyArg[1] = arg1;
+  sysexReplySent = 0;
+}
+
+/** @brief Indica se há uma resposta SysEx pendente. */
+inline bool sysexReplyPending() {
+  return sysexReplyCommand != 0;
+}
+
+/** @brief Indica se a resposta pendente já começou a sair (midiTransmit() espera o F7). */
+bool sysexReplyStarted() {
+  return sysexReplyCommand != 0 && sysexReplySent > 0;
+}
+
+void calibrationReplyPeaks(); // Definida em @ref CALIBRATION
+
+/**
+ * @brief Monta a resposta pendente do início ao fim; sysexReplyFits() escolhe o que sai.
+ * @details Cada valor é lido na passagem em que sai.
+ */
+void sysexReplyBuild() {
+  const uint8_t *arg = sysexReplyArg;
+  sysexReplyBegin();
+  switch (sysexReplyCommand) {
+#if PROFILING_ENABLED
+    case SYSEX_CMD_PROFILE_REPLY:
+      sysexReplyPut(profLoopMin, 5);
+      sysexReplyPut(profLoopCount ? profLoopSum / profLoopCount : 0, 5);
+      sysexReplyPut(profLoopMax, 5);
+      sysexReplyPut(midiOverflowCount, 3);
+      sysexReplyPut(NUM_KIT_PADS, 1);
+      for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+        uint16_t windows = profPeakWindows[p];
+        sysexReplyPut(windows ? profPeakSamplesMin[p] : 0, 3);
+        sysexReplyPut(windows ? profPeakSamplesSum[p] / windows : 0, 3);
+        sysexReplyPut(profPeakSamplesMax[p], 3);
+        sysexReplyPut(profCrosstalkDiscards[p], 3);
+      }
+      sysexReplyPut(PROF_LATENCY_BINS, 1);
+      for (uint8_t i = 0; i < PROF_LATENCY_BINS; i++) sysexReplyPut(profLatencyHist[i], 3);
+      sysexReplyPut(PROF_STATE_COUNT, 1);
+      for (uint8_t i = 0; i < PROF_STATE_COUNT; i++) {
+        sysexReplyPut(profStateSteps[i] ? profStateCyclesSum[i] / profStateSteps[i] : 0, 3);
+        sysexReplyPut(profStateCyclesMax[i], 3);
+      }
+      break;
+#endif
+    case SYSEX_CMD_MIDI_STATS_REPLY:
+      sysexReplyPut(midiOverflowCount, 3);
+      sysexReplyPut(midiMergedCount, 3);
+      sysexReplyPut(MIDI_QUEUE_COUNT, 1);
+      for (uint8_t q = 0; q < MIDI_QUEUE_COUNT; q++) {
+        sysexReplyPut(midiQueueDepth(q), 1);
+        sysexReplyPut(midiQueueMax[q], 1);
+        sysexReplyPut(min(midiDelayMaxUs[q], 0x1FFFFFUL), 3);
+      }
+      break;
+
+    case SYSEX_CMD_LOOP_STATS_REPLY:
+      sysexReplyPut(LOOP_BUDGET_US, 3);
+      sysexReplyPut(loopOverruns, 3);
+      sysexReplyPut(min(loopLongestUs, 0x1FFFFFUL), 3);
+      sysexReplyPut(loopDegradedEntries, 3);
+      sysexReplyPut(loopDegraded, 1);
+      break;
+
+    case SYSEX_CMD_CONFIG_ACK: // <comando> <ok>
+      sysexReplyPut(arg[0], 1);
+      sysexReplyPut(arg[1], 1);
+      break;
+
+    case SYSEX_CMD_CONFIG_REPLY: { // <peça>
+      uint8_t count = (arg[0] == CONFIG_GLOBAL) ? (uint8_t)GLOBAL_PARAM_COUNT : (uint8_t)PAD_PARAM_COUNT;
+      sysexReplyPut(arg[0], 1);
+      sysexReplyPut(count, 1);
+      for (uint8_t i = 0; i < count; i++) sysexReplyPut(configGetParam(arg[0], i), 3);
+      break;
+    }
+
+    case SYSEX_CMD_KIT_REPLY:
+      sysexReplyPut(kitActive, 1);
+      sysexReplyPut(kitNextPad < NUM_KIT_PADS, 1);
+      sysexReplyPut(KIT_PROFILE_COUNT, 1);
+      sysexReplyPut(configStoredValid, 1);
+      break;
+
+    case SYSEX_CMD_RULE_REPLY: { // <índice>
+      const ZoneRule &rule = zoneRules[arg[0]];
+      sysexReplyPut(arg[0], 1);
+      sysexReplyPut(ZONE_RULE_FIELDS, 1);
+      sysexReplyPut(rule.pad, 2);
+      sysexReplyPut(rule.zone, 2);
+      sysexReplyPut(rule.reference, 2);
+      sysexReplyPut(rule.ratioNum, 2);
+      sysexReplyPut(rule.ratioDen, 2);
+      sysexReplyPut(rule.thresholdMul, 2);
+      sysexReplyPut(rule.referenceMin, 2);
+      sysexReplyPut(rule.referenceMax, 2);
+      sysexReplyPut(rule.note, 2);
+      sysexReplyPut(rule.velocity, 2);
+      break;
+    }
+
+    case SYSEX_CMD_XTALK_REPLY: // <origem>
+      sysexReplyPut(arg[0], 1);
+      sysexReplyPut(NUM_KIT_PADS, 1);
+      for (uint8_t v = 0; v < NUM_KIT_PADS; v++) {
+        sysexReplyPut(crosstalkMatrix[arg[0]][v].ratioQ8, 2);
+        sysexReplyPut(crosstalkMatrix[arg[0]][v].windowMs, 2);
+      }
+      break;
+
+    case SYSEX_CMD_CALIBRATION_PEAKS:
+      calibrationReplyPeaks();
+      break;
+
+    default:
+      break;
+  }
+  sysexReplySend();
+}
+
+/**
+ * @brief Envia, sem bloquear, a parte da resposta pendente que cabe na porta.
+ * @details Chamada a cada passagem do `loop()`. A resposta só começa com as filas de saída
+ * vazias, esvaziadas sem a espera do modo degradado (@ref LOOP_BUDGET). Depois do F0,
+ * midiTransmit() espera o F7: nenhuma mensagem de canal pode entrar no meio da SysEx.
+ */
+void sysexReplyService() {
+  if (sysexReplyCommand == 0) return;
+  if (sysexReplySent == 0) {
+    midiTransmit(true);
+    if (midiPending()) return;
+    midiRunningStatus = 0; // SysEx cancela o running status
+  }
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  uint16_t sent = sysexReplySent;
+  sysexReplyRoom = 3 * (MIDI_TX_CHUNK / 4); // Bytes MIDI em MIDI_TX_CHUNK bytes de pacotes
+#else
+  sysexReplyRoom = min(MIDI_PORT.availableForWrite(), MIDI_TX_CHUNK);
+#endif
+  sysexReplyOffset = 0;
+  sysexReplyBuild();
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  if (sysexReplySent != sent) MidiUSB.flush();
+#endif
+}
+
+/**
+ * @brief Lê um valor enviado em grupos de 7 bits (do menos para o mais significativo).
+ * @param data Primeiro grupo.
+ * @param septets Número de grupos.
+ * @return Valor remontado.
+ */
+uint32_t sysexValue(const uint8_t *data, uint8_t septets) {
+  uint32_t value = 0;
+  for (uint8_t i = septets; i > 0; i--) value = (value << 7) | (data[i - 1] & 0x7F);
+  return value;
+}
+
+void calibrationSetActive(bool active); // Definida em @ref CALIBRATION
+bool captureStart(const uint8_t *data, uint8_t length); // Definidas em @ref CAPTURE
+void captureStop();
+
+/**
+ * @brief Trata uma mensagem SysEx completa.
+ * @param message Bytes entre F0 e F7 (a partir do identificador de fabricante).
+ * @param length Número de bytes em `message`.
+ */
+void sysexHandle(const uint8_t *message, uint8_t length) {
+  if (length < 2 || message[0] != SYSEX_MANUFACTURER_ID) return;
+
+  switch (message[1]) {
+#if PROFILING_ENABLED
+    case SYSEX_CMD_PROFILE_QUERY:
+      sysexReplyStart(SYSEX_CMD_PROFILE_REPLY);
+      break;
+
+    case SYSEX_CMD_PROFILE_RESET:
+      profReset();
+      midiOverflowCount = 0;
+      break;
+#endif
+    case SYSEX_CMD_MIDI_STATS_QUERY:
+      sysexReplyStart(SYSEX_CMD_MIDI_STATS_REPLY);
+      break;
+
+    case SYSEX_CMD_MIDI_STATS_RESET:
+      midiStatsReset();
+      break;
+
+    case SYSEX_CMD_LOOP_STATS_QUERY:
+      sysexReplyStart(SYSEX_CMD_LOOP_STATS_REPLY);
+      break;
+
+    case SYSEX_CMD_LOOP_STATS_RESET:
+      loopBudgetReset();
+      break;
+
+    case SYSEX_CMD_CALIBRATION_START:
+    case SYSEX_CMD_CALIBRATION_STOP:
+      captureStop();
+      calibrationSetActive(message[1] == SYSEX_CMD_CALIBRATION_START);
+      break;
+
+    case SYSEX_CMD_CAPTURE_START: {
+      calibrationSetActive(false);
+      bool ok = captureStart(&message[2], length - 2);
+      sysexReplyStart(SYSEX_CMD_CONFIG_ACK, SYSEX_CMD_CAPTURE_START, ok);
+      break;
+    }
+
+    case SYSEX_CMD_CAPTURE_STOP:
+      captureStop();
+      break;
+
+    case SYSEX_CMD_XTALK_SET: {
+      if (length < 3 || message[2] >= NUM_KIT_PADS) break;
+      uint8_t source = message[2];
+      for (uint8_t v = 0; v < NUM_KIT_PADS && 3 + 4 * (v + 1) <= length; v++) {
+        const uint8_t *entry = &message[3 + 4 * v];
+        crosstalkMatrix[source][v].ratioQ8 = min(sysexValue(entry, 2), 255UL);
+        crosstalkMatrix[source][v].windowMs = min(sysexValue(entry + 2, 2), 255UL);
+      }
+      crosstalkMatrix[source][source].windowMs = 0; // A diagonal nunca tem acoplamento
+      break;
+    }
+
+    case SYSEX_CMD_CONFIG_SET: {
+      bool ok = length >= 7 && configSetParam(message[2], message[3], sysexValue(&message[4], 3));
+      sysexReplyStart(SYSEX_CMD_CONFIG_ACK, SYSEX_CMD_CONFIG_SET, ok);
+      break;
+    }
+
+    case SYSEX_CMD_CONFIG_QUERY:
+      if (length < 3 || (message[2] >= NUM_KIT_PADS && message[2] != CONFIG_GLOBAL)) break;
+      sysexReplyStart(SYSEX_CMD_CONFIG_REPLY, message[2]);
+      break;
+
+    case SYSEX_CMD_CONFIG_SAVE:
+    case SYSEX_CMD_CONFIG_LOAD:
+    case SYSEX_CMD_CONFIG_DEFAULTS: {
+      bool ok = true;
+      if (message[1] == SYSEX_CMD_CONFIG_SAVE) configSave();
+      else if (message[1] == SYSEX_CMD_CONFIG_LOAD) ok = configLoad();
+      else configDefaults();
+      if (message[1] != SYSEX_CMD_CONFIG_SAVE && ok) kitLoaded(message[1] == SYSEX_CMD_CONFIG_LOAD ? KIT_PROFILE_USER : KIT_PROFILE_FACTORY);
+      velocityLutBegin();
+      sysexReplyStart(SYSEX_CMD_CONFIG_ACK, message[1], ok);
+      break;
+    }
+
+    case SYSEX_CMD_KIT_SELECT: {
+      bool ok = length >= 3 && kitSelect(message[2]);
+      sysexReplyStart(SYSEX_CMD_CONFIG_ACK, SYSEX_CMD_KIT_SELECT, ok);
+      break;
+    }
+
+    case SYSEX_CMD_KIT_QUERY:
+      sysexReplyStart(SYSEX_CMD_KIT_REPLY);
+      break;
+
+    case SYSEX_CMD_RULE_SET: {
+      bool ok = length >= 3 + 2 * ZONE_RULE_FIELDS && message[2] < ZONE_RULE_MAX;
+      if (ok) {
+        uint16_t field[ZONE_RULE_FIELDS];
+        for (uint8_t i = 0; i < ZONE_RULE_FIELDS; i++) {
+          field[i] = sysexValue(&message[3 + 2 * i], 2);
+          if (i != 6 && i != 7 && field[i] > 0xFF) ok = false; // Só os limites da faixa têm 16 bits
+        }
+        ZoneRule rule = { (uint8_t)field[0], (uint8_t)field[1], (uint8_t)field[2], (uint8_t)field[3], (uint8_t)field[4],
+                          (uint8_t)field[5], field[6], field[7], (uint8_t)field[8], (uint8_t)field[9] };
+        ok = ok && zoneRuleSet(message[2], rule);
+      }
+      sysexReplyStart(SYSEX_CMD_CONFIG_ACK, SYSEX_CMD_RULE_SET, ok);
+      break;
+    }
+
+    case SYSEX_CMD_RULE_QUERY:
+      if (length < 3 || message[2] >= ZONE_RULE_MAX) break;
+      sysexReplyStart(SYSEX_CMD_RULE_REPLY, message[2]);
+      break;
+
+    case SYSEX_CMD_XTALK_QUERY:
+      if (length < 3 || message[2] >= NUM_KIT_PADS) break;
+      sysexReplyStart(SYSEX_CMD_XTALK_REPLY, message[2]);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Recebe um byte da porta MIDI e monta a mensagem SysEx.
+ * @details Também reconhece os Program Changes de troca de perfil, com ou sem running status.
+ * @param b Byte recebido.
+ */
+void sysexReceive(uint8_t b) {
+  if (b == 0xF0) {
+    sysexReceiving = true;
+    sysexProgramChange = false;
+    sysexLength = 0;
+  } else if (b == 0xF7) {
+    if (sysexReceiving) sysexHandle(sysexBuffer, sysexLength);
+    sysexReceiving = false;
+  } else if (b & 0x80) {
+    if (b < 0xF8) { // Outra mensagem interrompe a SysEx (exceto tempo real)
+      sysexReceiving = false;
+      sysexProgramChange = (b == (0xC0 | KIT_PROGRAM_CHANNEL));
+    }
+  } else if (sysexReceiving) {
+    if (sysexLength < SYSEX_MAX_LEN) sysexBuffer[sysexLength++] = b;
+    else sysexReceiving = false; // Mensagem longa demais: descarta
+  } else if (sysexProgramChange) {
+    kitSelect(b); // Programa = perfil (@ref KIT_PROFILES); inexistentes são ignorados
+  }
+}
+
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+/**
+ * @brief Bytes MIDI úteis em um pacote USB-MIDI, indexado pelo Code Index Number (CIN).
+ * @details 0x2-0x3: System Common; 0x4-0x7: SysEx; 0x8-0xE: mensagens de canal
+ * (0xC e 0xD, Program Change e Channel Pressure, têm 2 bytes); 0xF: byte único.
+ */
+const uint8_t usbMidiCinLength[16] PROGMEM = {
+  0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+#endif
+
+/**
+ * @brief Lê, sem bloquear, os bytes recebidos na porta MIDI.
+ * @details Para numa mensagem que pede resposta: o restante espera na porta até o F7 dela.
+ */
+void sysexPoll() {
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+  while (!sysexReplyPending()) {
+    midiEventPacket_t rx = MidiUSB.read();
+    if (rx.header == 0) break;
+    uint8_t count = pgm_read_byte(&usbMidiCinLength[rx.header & 0x0F]);
+    const uint8_t data[3] = { rx.byte1, rx.byte2, rx.byte3 };
+    for (uint8_t i = 0; i < count; i++) sysexReceive(data[i]);
+  }
+#else
+  while (!sysexReplyPending() && MIDI_PORT.available() > 0) {
+    sysexReceive(MIDI_PORT.read());
+  }
+#endif
+}
+/** @} */
+
+/**
+ * @defgroup CALIBRATION Calibração de Crosstalk
+ * @brief Captura dos picos simultâneos de todos os sensores para ajustar a matriz de crosstalk.
+ * @details Ativado por `SYSEX_CMD_CALIBRATION_START`. Enquanto ativo, o motor de pads e o
+ * pedal ficam parados (nenhuma nota é enviada) e o `loop()` só chama calibrationStep().
+ * Quando qualquer sensor passa do início da sua tabela de velocidade (o `threshold` da
+ * zona), todos os sensores são acompanhados por `CALIBRATION_WINDOW_US`; depois, uma
+ * mensagem `SYSEX_CMD_CALIBRATION_PEAKS` informa o sensor que disparou e, para cada sensor
+ * (@ref PAD_INDICES), o maior valor lido e quantos µs após o disparo ele ocorreu:
+ * `F0 7D 22 <sensor> <n> {pico (2 grupos), atraso (3 grupos)}... F7`.
+ *
+ * O baterista toca cada peça várias vezes, uma de cada vez; a ferramenta `sim/xtalk_fit.cpp`
+ * ajusta as razões e janelas a partir dessas mensagens e gera os `SYSEX_CMD_XTALK_SET`.
+ * @{
+ */
+#define CALIBRATION_WINDOW_US  40000UL  /**< Duração da captura após o disparo. */
+#define CALIBRATION_HOLDOFF_US 250000UL /**< Espera após uma captura, para o toque terminar de soar. */
+
+/** @brief Indica se o modo de calibração está ativo. */
+bool calibrationActive = false;
+/** @brief Indica se há uma captura em andamento. */
+bool calibrationCapturing = false;
+/** @brief Sensor que disparou a captura atual. */
+uint8_t calibrationTrigger = 0;
+/** @brief Instante do disparo (ou, sem captura, o fim da espera). */
+padTime_t calibrationTime = 0;
+/** @brief Maior valor de cada sensor na captura atual. */
+uint16_t calibrationPeak[NUM_PADS];
+/** @brief Atraso (em µs) do pico de cada sensor em relação ao disparo. */
+uint16_t calibrationPeakDelay[NUM_PADS];
+
+/** @brief Corpo de `SYSEX_CMD_CALIBRATION_PEAKS`, montado por sysexReplyBuild(). */
+void calibrationReplyPeaks() {
+  sysexReplyPut(calibrationTrigger, 1);
+  sysexReplyPut(NUM_PADS, 1);
+  for (uint8_t i = 0; i < NUM_PADS; i++) {
+    sysexReplyPut(calibrationPeak[i], 2);
+    sysexReplyPut(calibrationPeakDelay[i], 3);
+  }
+}
+
+/**
+ * @brief Liga ou desliga o modo de calibração.
+ * @details Ao sair, todas as peças voltam a `PAD_STATE_IDLE`.
+ * @param active `true` para entrar no modo de calibração.
+ */
+void calibrationSetActive(bool active) {
+  calibrationActive = active;
+  calibrationCapturing = false;
+  calibrationTime = padNow();
+  for (uint8_t i = 0; i < NUM_PADS; i++) scanTake(i); // Descarta picos anteriores
+  if (!active) {
+    for (uint8_t p = 0; p < NUM_KIT_PADS; p++) padRuntime[p].state = PAD_STATE_IDLE;
+  }
+}
+
+/**
+ * @brief Um passo do modo de calibração: detecta o disparo, acompanha e envia os picos.
+ * @param now Instante atual (padNow()).
+ */
+void calibrationStep(padTime_t now) {
+  uint16_t reading[NUM_PADS];
+  for (uint8_t i = 0; i < NUM_PADS; i++) reading[i] = scanTake(i);
+
+  if (!calibrationCapturing) {
+    if ((long)(now - calibrationTime) < 0 || sysexReplyPending()) return; // Espera após a captura anterior e o envio dos picos
+    for (uint8_t i = 0; i < NUM_PADS; i++) {
+      if ((int)reading[i] > velocityLutBase[i] && !calibrationCapturing) {
+        calibrationCapturing = true;
+        calibrationTrigger = i;
+        calibrationTime = now;
+      }
+    }
+    if (!calibrationCapturing) return;
+    for (uint8_t i = 0; i < NUM_PADS; i++) {
+      calibrationPeak[i] = reading[i];
+      calibrationPeakDelay[i] = 0;
+    }
+    return;
+  }
+
+  padTime_t elapsed = now - calibrationTime;
+  for (uint8_t i = 0; i < NUM_PADS; i++) {
+    if (reading[i] > calibrationPeak[i]) {
+      calibrationPeak[i] = reading[i];
+#if PAD_TIMING_MICROS
+      calibrationPeakDelay[i] = elapsed;
+#else
+      calibrationPeakDelay[i] = elapsed * 1000UL;
+#endif
+    }
+  }
+  if (elapsed < PAD_TIME(CALIBRATION_WINDOW_US) || sysexReplyPending()) return; // Outra resposta ocupa a porta: continua acompanhando
+
+  sysexReplyStart(SYSEX_CMD_CALIBRATION_PEAKS);
+  calibrationCapturing = false;
+  calibrationTime = now + PAD_TIME(CALIBRATION_HOLDOFF_US);
+}
+/** @} */
+
+/**
+ * @defgroup CAPTURE Captura das Amostras Brutas
+ * @brief Envio das leituras do ADC de sensores escolhidos, para análise e reprodução no computador.
+ * @details Ativado por `SYSEX_CMD_CAPTURE_START`:
+ * `F0 7D 26 <modo> <limiar (2 grupos)> <pré (2 grupos)> <pós (2 grupos)> <sensor>... F7`,
+ * com até `CAPTURE_MAX_CHANNELS` sensores (@ref PAD_INDICES). Enquanto ativo, o motor de
+ * pads e o pedal ficam parados, como na calibração. A interrupção da varredura grava cada
+ * amostra dos sensores escolhidos num buffer circular de `CAPTURE_RING_LEN` leituras, na
+ * taxa cheia da varredura; o `loop()` as compacta e envia pela serial USB (`CAPTURE_PORT`).
+ * O buffer reaproveita a memória das tabelas de velocidade, sem uso enquanto o motor está
+ * parado, e as tabelas são regeneradas quando a captura termina.
+ * - `CAPTURE_MODE_STREAM`: envio contínuo até `SYSEX_CMD_CAPTURE_STOP`. Quadros que não
+ *   cabem no buffer (a porta não acompanha a taxa) são descartados e contados.
+ * - `CAPTURE_MODE_TRIGGER`: o buffer gira até uma amostra passar do limiar; então grava
+ *   mais `pós` quadros, envia até `pré` quadros anteriores ao disparo, o disparo e os
+ *   posteriores, e encerra sozinho. Um toque inteiro sai em alta resolução sem limitar o
+ *   envio à banda da porta.
+ *
+ * Um quadro é uma amostra de cada sensor escolhido, em ordem crescente de sensor (a ordem
+ * da varredura). Formato enviado, todo em bytes:
+ * - cabeçalho: `DC 43 41 50`, versão (`CAPTURE_VERSION`), modo, número de sensores `n`,
+ *   os `n` sensores, taxa por sensor em Hz (4 bytes, LSB primeiro) e quadros antes do
+ *   disparo (2 bytes, LSB primeiro; 0 no modo contínuo);
+ * - cada amostra: `0x00-0x7F` = diferença de -64 a 63 para a amostra anterior do mesmo
+ *   sensor (7 bits, complemento de dois), ou `0x80 | (valor >> 7)` seguido de
+ *   `valor & 0x7F` = valor absoluto. A primeira amostra de cada sensor parte de 0;
+ * - `CAPTURE_CODE_GAP`, seguido de 2 bytes (LSB primeiro): quadros descartados aqui;
+ * - `CAPTURE_CODE_END`: fim da captura.
+ *
+ * No transporte `MIDI_TRANSPORT_SERIAL` a porta da captura é a própria porta do MIDI, e o
+ * fluxo vem depois da confirmação SysEx do comando. `sim_trace.h` lê o fluxo gravado como
+ * um traço: o `drum_sim` e a bancada reproduzem a captura diretamente.
+ * @{
+ */
+#if CAPTURE_ENABLED
+#define CAPTURE_PORT          Serial /**< Porta da captura: a serial USB (CDC). */
+#define CAPTURE_MAX_CHANNELS  8      /**< Máximo de sensores numa captura. */
+#define CAPTURE_RING_LEN      256    /**< Leituras no buffer (índices de 8 bits com volta natural). */
+#define CAPTURE_TX_CHUNK      64     /**< Máximo de bytes enviados por passagem do `loop()`. */
+#define CAPTURE_VERSION       1      /**< Versão do formato enviado. */
+#define CAPTURE_NO_SLOT       0xFF   /**< `captureSlot[]` de um sensor fora da captura. */
+#define CAPTURE_CODE_ABSOLUTE 0x80   /**< Prefixo de uma amostra com valor absoluto. */
+#define CAPTURE_CODE_GAP      0xF0   /**< Marca de quadros descartados. */
+#define CAPTURE_CODE_END      0xFF   /**< Marca de fim da captura. */
+
+static_assert(sizeof(velocityLut) >= CAPTURE_RING_LEN * sizeof(uint16_t), "O buffer da captura não cabe nas tabelas de velocidade");
+
+/** @brief Modos de captura. */
+enum CaptureMode {
+  CAPTURE_MODE_STREAM, /**< Envio contínuo. */
+  CAPTURE_MODE_TRIGGER /**< Um toque, com pré e pós-disparo. */
+};
+
+/** @brief Estados da captura (`captureState`). */
+enum CaptureState {
+  CAPTURE_OFF,       /**< Sem captura: o motor de pads roda normalmente. */
+  CAPTURE_STREAMING, /**< Modo contínuo: gravando e enviando. */
+  CAPTURE_ARMED,     /**< Modo com disparo: buffer girando à espera do limiar. */
+  CAPTURE_POST_ROLL, /**< Disparou: gravando os quadros posteriores. */
+  CAPTURE_SENDING    /**< Gravação encerrada: enviando o buffer. */
+};
+
+/** @brief Buffer circular da captura, sobre `velocityLut[]`. */
+uint16_t *const captureRing = (uint16_t *)velocityLut;
+/** @brief Estado atual (@ref CaptureState); lido pela interrupção a cada amostra. */
+volatile uint8_t captureState = CAPTURE_OFF;
+/** @brief Modo da captura atual (@ref CaptureMode). */
+uint8_t captureMode;
+/** @brief Posição de cada sensor no quadro, ou `CAPTURE_NO_SLOT`. */
+uint8_t captureSlot[NUM_PADS];
+/** @brief Sensores da captura, em ordem crescente. */
+uint8_t captureSensor[CAPTURE_MAX_CHANNELS];
+/** @brief Número de sensores da captura (amostras por quadro). */
+uint8_t captureChannels = 0;
+/** @brief Próxima posição a ser escrita pela interrupção. */
+volatile uint8_t captureHead;
+/** @brief Próxima posição a ser enviada (no pré-disparo, a interrupção também a avança). */
+volatile uint8_t captureTail;
+/** @brief Início do quadro em gravação. */
+volatile uint8_t captureFrameHead;
+/** @brief Início do quadro em que o limiar foi ultrapassado. */
+volatile uint8_t captureTriggerHead;
+/** @brief Indica que o quadro atual não é gravado (sem espaço, ou gravação encerrada). */
+volatile bool captureSkip;
+/** @brief Posição no quadro da próxima amostra esperada. */
+volatile uint8_t captureNextSlot;
+/** @brief Quadros descartados ainda não informados (satura em 0xFFFF). */
+volatile uint16_t captureLost;
+/** @brief Quadros que ainda faltam gravar após o disparo. */
+volatile uint16_t capturePostLeft;
+/** @brief Limiar de disparo. */
+uint16_t captureTriggerLevel;
+/** @brief Quadros pedidos antes do disparo. */
+uint16_t capturePre;
+/** @brief Indica que o cabeçalho ainda não foi enviado. */
+bool captureHeaderPending;
+/** @brief Última amostra enviada de cada sensor, base das diferenças. */
+uint16_t capturePrev[CAPTURE_MAX_CHANNELS];
+
+/** @brief Quadros que cabem no buffer. */
+inline uint8_t captureCapacity() {
+  return (CAPTURE_RING_LEN - 1) / captureChannels;
+}
+
+/**
+ * @brief Início de um quadro na interrupção: decide se ele é gravado.
+ * @details No modo contínuo, sem espaço, descarta o quadro; no pré-disparo, descarta o
+ * quadro mais antigo. Ao fim do pós-disparo, encerra a gravação. Um quadro anterior
+ * incompleto, possível enquanto a agenda da varredura volta a ser uniforme
+ * (`SCAN_SCHEDULING`), é descartado.
+ */
+void captureFrameBegin() {
+  if (!captureSkip && captureNextSlot != captureChannels) captureHead = captureFrameHead;
+  uint8_t state = captureState;
+  captureSkip = true;
+  captureNextSlot = 0;
+  if (state == CAPTURE_POST_ROLL) {
+    if (capturePostLeft == 0) {
+      captureState = CAPTURE_SENDING;
+      return;
+    }
+    capturePostLeft--;
+  } else if (state != CAPTURE_STREAMING && state != CAPTURE_ARMED) {
+    return;
+  }
+  uint8_t used = captureHead - captureTail;
+  if (used > CAPTURE_RING_LEN - 1 - captureChannels) {
+    if (state == CAPTURE_STREAMING) {
+      if (captureLost != 0xFFFF) captureLost++;
+      return;
+    }
+    captureTail += captureChannels;
+  }
+  captureFrameHead = captureHead;
+  captureSkip = false;
+}
+
+/**
+ * @brief Grava uma amostra de um sensor escolhido; chamada por scanStoreSample().
+ * @param pad Índice do sensor (@ref PAD_INDICES).
+ * @param sample Valor de 10 bits lido do ADC.
+ */
+void captureStore(uint8_t pad, uint16_t sample) {
+  uint8_t slot = captureSlot[pad];
+  if (slot == CAPTURE_NO_SLOT) return;
+  if (slot == 0) captureFrameBegin();
+  if (captureSkip) return;
+  if (slot != captureNextSlot) { // Fora de ordem: descarta o quadro
+    captureHead = captureFrameHead;
+    captureSkip = true;
+    return;
+  }
+  captureNextSlot = slot + 1;
+  uint8_t head = captureHead;
+  captureRing[head] = sample;
+  captureHead = head + 1;
+  if (captureState == CAPTURE_ARMED && sample > captureTriggerLevel) {
+    captureTriggerHead = captureFrameHead;
+    captureState = CAPTURE_POST_ROLL;
+  }
+}
+
+/**
+ * @brief Inicia uma captura.
+ * @param data Parâmetros de `SYSEX_CMD_CAPTURE_START`, a partir do modo.
+ * @param length Bytes em `data`.
+ * @return `false` se os parâmetros forem inválidos (a captura não começa).
+ */
+bool captureStart(const uint8_t *data, uint8_t length) {
+  captureStop();
+  if (length < 8 || length - 7 > CAPTURE_MAX_CHANNELS || data[0] > CAPTURE_MODE_TRIGGER) return false;
+
+  uint8_t slot[NUM_PADS];
+  memset(slot, CAPTURE_NO_SLOT, sizeof(slot));
+  for (uint8_t i = 7; i < length; i++) {
+    if (data[i] >= NUM_PADS) return false;
+    slot[data[i]] = 0;
+  }
+  uint8_t channels = 0;
+  for (uint8_t pad = 0; pad < NUM_PADS; pad++) { // Ordem da varredura; repetidos contam uma vez
+    if (slot[pad] == CAPTURE_NO_SLOT) continue;
+    slot[pad] = channels;
+    captureSensor[channels++] = pad;
+  }
+
+  captureMode = data[0];
+  captureTriggerLevel = sysexValue(&data[1], 2);
+  captureChannels = channels;
+  uint16_t post = min(sysexValue(&data[5], 2), (uint32_t)captureCapacity() - 1);
+  capturePre = min(sysexValue(&data[3], 2), (uint32_t)captureCapacity() - 1 - post);
+  capturePostLeft = post;
+  captureHead = captureTail = 0;
+  captureLost = 0;
+  captureSkip = true;
+  captureHeaderPending = true;
+  memcpy(captureSlot, slot, sizeof(captureSlot));
+#if MIDI_TRANSPORT != MIDI_TRANSPORT_SERIAL
+  CAPTURE_PORT.begin(115200); // A serial USB ignora a taxa
+#endif
+  captureState = (captureMode == CAPTURE_MODE_TRIGGER) ? CAPTURE_ARMED : CAPTURE_STREAMING; // Liga a gravação por último
+  return true;
+}
+
+/** @brief Envia o cabeçalho da captura e zera as bases das diferenças. */
+void captureSendHeader(uint16_t pre) {
+  uint8_t header[13 + CAPTURE_MAX_CHANNELS];
+  uint8_t length = 0;
+  header[length++] = 0xDC;
+  header[length++] = 'C';
+  header[length++] = 'A';
+  header[length++] = 'P';
+  header[length++] = CAPTURE_VERSION;
+  header[length++] = captureMode;
+  header[length++] = captureChannels;
+  for (uint8_t i = 0; i < captureChannels; i++) header[length++] = captureSensor[i];
+  for (uint8_t i = 0; i < 4; i++) header[length++] = SCAN_SAMPLE_RATE_HZ >> (8 * i);
+  header[length++] = pre;
+  header[length++] = pre >> 8;
+  CAPTURE_PORT.write(header, length);
+  memset(capturePrev, 0, sizeof(capturePrev));
+  captureHeaderPending = false;
+}
+
+/** @brief Encerra a captura e devolve o módulo ao funcionamento normal. */
+void captureStop() {
+  if (captureState == CAPTURE_OFF) return;
+  captureState = CAPTURE_OFF; // Para a gravação antes de liberar o buffer
+  if (!captureHeaderPending) CAPTURE_PORT.write((uint8_t)CAPTURE_CODE_END);
+  velocityLutBegin();
+  for (uint8_t i = 0; i < NUM_PADS; i++) scanTake(i); // Descarta picos do período da captura
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) padRuntime[p].state = PAD_STATE_IDLE;
+}
+
+/**
+ * @brief Compacta uma amostra no formato da captura.
+ * @param out Recebe 1 ou 2 bytes.
+ * @param channel Posição do sensor no quadro.
+ * @param sample Amostra.
+ * @return Bytes escritos.
+ */
+uint8_t captureEncode(uint8_t *out, uint8_t channel, uint16_t sample) {
+  int delta = (int)sample - capturePrev[channel];
+  capturePrev[channel] = sample;
+  if (delta >= -64 && delta <= 63) {
+    out[0] = delta & 0x7F;
+    return 1;
+  }
+  out[0] = CAPTURE_CODE_ABSOLUTE | (sample >> 7);
+  out[1] = sample & 0x7F;
+  return 2;
+}
+
+/** @brief Um passo da captura no `loop()`: envia os quadros gravados que cabem na porta. */
+void captureService() {
+  if (sysexReplyPending()) return; // A confirmação do comando sai antes do fluxo
+  uint8_t state = captureState;
+  if (state == CAPTURE_ARMED || state == CAPTURE_POST_ROLL) return; // Ainda gravando o toque
+  if (captureHeaderPending) {
+    uint16_t pre = 0;
+    if (state == CAPTURE_SENDING) { // Só os quadros pedidos antes do disparo
+      pre = min((uint16_t)(uint8_t)(captureTriggerHead - captureTail) / captureChannels, capturePre);
+      captureTail = captureTriggerHead - pre * captureChannels;
+    }
+    captureSendHeader(pre);
+  }
+
+  int space = min(CAPTURE_PORT.availableForWrite(), CAPTURE_TX_CHUNK);
+  uint8_t buffer[CAPTURE_TX_CHUNK];
+  uint8_t length = 0;
+  if (captureLost && space >= 3) {
+    HAL_ATOMIC_BEGIN();
+    uint16_t lost = captureLost;
+    captureLost = 0;
+    HAL_ATOMIC_END();
+    buffer[length++] = CAPTURE_CODE_GAP;
+    buffer[length++] = lost;
+    buffer[length++] = lost >> 8;
+  }
+  uint8_t tail = captureTail;
+  while ((uint8_t)(captureHead - tail) >= captureChannels && length + 2 * captureChannels <= space) {
+    for (uint8_t c = 0; c < captureChannels; c++) length += captureEncode(&buffer[length], c, captureRing[tail++]);
+  }
+  captureTail = tail; // Libera as posições enviadas para a interrupção
+  if (length) CAPTURE_PORT.write(buffer, length);
+
+  if (state == CAPTURE_SENDING && tail == captureHead) captureStop();
+}
+#else
+inline bool captureStart(const uint8_t *, uint8_t) { return false; }
+inline void captureStop() {}
+#endif
+/** @} */
+
+/**
+ * @defgroup CHAIN Placas em Cadeia (Mestre e Secundária)
+ * @brief Um kit com duas placas e uma única saída MIDI, com a ordem dos toques preservada.
+ * @details Com mais sensores do que as entradas de uma placa, uma segunda placa roda o
+ * mesmo firmware com `CHAIN_ROLE_SLAVE` e a principal com `CHAIN_ROLE_MASTER`, ligadas
+ * pela Serial1 (`CHAIN_PORT`, TX de uma no RX da outra, e o terra em comum). A secundária
+ * roda o motor de pads normalmente, mas midiTransmit() envia cada evento (note-on, CC da
+ * posição, note-off agendado) ao mestre num quadro compacto. O mestre põe esses eventos
+ * nas suas filas com o instante de origem convertido para o seu tempo, e o escalonador
+ * (@ref MIDI_OUTPUT) os envia junto com os locais, pelo instante em que cada peça foi
+ * tocada. O computador vê uma única porta, sem a variação entre dois fluxos USB.
+ *
+ * Não há sincronia de relógio: o quadro leva a idade do evento (µs desde o instante de
+ * origem até a escrita, incluindo os bytes à frente na fila da UART), e quem recebe
+ * desconta essa idade, a duração do quadro na linha e os bytes que chegaram depois dele
+ * do instante em que o lê. O erro que sobra é o intervalo entre a chegada e a leitura no
+ * `loop()`, bem menor que o milissegundo de cada quadro USB.
+ *
+ * O mestre também envia à secundária um quadro de cada toque seu, e cada placa trata um
+ * toque recente da outra como uma fonte de crosstalk a mais (`crosstalkRemote`). É só o
+ * vazamento entre placas: a matriz completa continua sendo a de cada placa.
+ *
+ * Quadro (`CHAIN_FRAME_LEN` bytes): status, dado 1, dado 2, peça de origem (0x7F =
+ * nenhuma), idade em µs (3 grupos de 7 bits, satura em ~2 s) e pico do toque >> 3 (0 =
+ * sem toque). Só o status tem o bit 7 em 1, o que ressincroniza a leitura após um byte
+ * perdido. No mestre, as peças da secundária aparecem nas filas como
+ * `CHAIN_REMOTE_PAD(peça)`.
+ * @note Uma placa tem uma só UART: a cadeia é de um mestre e uma secundária.
+ * @{
+ */
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+#define CHAIN_NO_PAD 0x7F                             /**< Peça de origem de um evento sem peça. */
+#define CHAIN_AGE_MAX 0x1FFFFFUL                      /**< Maior idade representável em 3 grupos (µs). */
+#define CHAIN_REMOTE_PAD(pad) (NUM_KIT_PADS + (pad))  /**< Peça de origem, nas filas do mestre, de uma peça da secundária. */
+
+uint8_t chainFrame[CHAIN_FRAME_LEN]; /**< Quadro em recepção. */
+uint8_t chainFrameLength = 0;        /**< Bytes já recebidos do quadro (0 = esperando um status). */
+
+/**
+ * @brief Monta um quadro da ligação.
+ * @param frame Recebe `CHAIN_FRAME_LEN` bytes.
+ * @param status Byte de status MIDI.
+ * @param data1 Primeiro byte de dados.
+ * @param data2 Segundo byte de dados.
+ * @param pad Peça de origem nesta placa, ou `MIDI_NO_PAD`.
+ * @param ageUs Tempo desde o instante de origem até o quadro começar a sair na linha.
+ * @return `CHAIN_FRAME_LEN`.
+ */
+uint8_t chainFrameBuild(uint8_t *frame, uint8_t status, uint8_t data1, uint8_t data2, uint8_t pad, unsigned long ageUs) {
+  ageUs = min(ageUs, CHAIN_AGE_MAX);
+  bool hit = pad < NUM_KIT_PADS && (status & 0xF0) == 0x90 && data2 > 0;
+  frame[0] = status;
+  frame[1] = data1;
+  frame[2] = data2;
+  frame[3] = (pad < NUM_KIT_PADS) ? pad : CHAIN_NO_PAD;
+  frame[4] = ageUs & 0x7F;
+  frame[5] = (ageUs >> 7) & 0x7F;
+  frame[6] = ageUs >> 14;
+  frame[7] = hit ? max(padRuntime[pad].crosstalkPeak >> 3, 1) : 0;
+  return CHAIN_FRAME_LEN;
+}
+
+#if CHAIN_ROLE == CHAIN_ROLE_SLAVE
+/**
+ * @brief Codifica um evento das filas MIDI num quadro para o mestre; chamada por midiTransmit().
+ * @param frame Recebe `CHAIN_FRAME_LEN` bytes.
+ * @param e Evento a enviar.
+ * @param now Instante atual (padNow()).
+ * @param backlog Bytes que sairão na linha antes deste quadro.
+ * @return Bytes escritos em `frame`.
+ */
+uint8_t chainEncode(uint8_t *frame, const MidiEvent &e, padTime_t now, uint8_t backlog) {
+#if PAD_TIMING_MICROS
+  unsigned long ageUs = (now - e.time) + backlog * CHAIN_BYTE_US;
+#else
+  unsigned long ageUs = (now - e.time) * 1000UL + backlog * CHAIN_BYTE_US;
+#endif
+  return chainFrameBuild(frame, e.status, e.data1, e.data2, e.pad, ageUs);
+}
+#else
+/**
+ * @brief Informa um toque do mestre à placa secundária, para o crosstalk entre placas.
+ * @details Descartado se a UART não tem espaço: é só uma dica para a outra placa.
+ * @param p Índice da peça em `padTable[]`.
+ * @param d Descrição da peça.
+ * @param velocity Velocidade da zona principal.
+ */
+void chainSendHit(uint8_t p, const PadDescriptor &d, int velocity) {
+  int space = CHAIN_PORT.availableForWrite();
+  if (space < CHAIN_FRAME_LEN) return;
+  uint8_t frame[CHAIN_FRAME_LEN];
+#if PAD_TIMING_MICROS
+  unsigned long ageUs = padNow() - padOnsetTime(p);
+#else
+  unsigned long ageUs = (padNow() - padOnsetTime(p)) * 1000UL;
+#endif
+  ageUs += (CHAIN_TX_BUFFER - space) * CHAIN_BYTE_US;
+  chainFrameBuild(frame, 0x90, d.note[0], constrain(velocity, 1, 127), p, ageUs);
+  CHAIN_PORT.write(frame, CHAIN_FRAME_LEN);
+}
+#endif
+
+/**
+ * @brief Trata um quadro completo recebido da outra placa.
+ * @param frame Os `CHAIN_FRAME_LEN` bytes do quadro.
+ * @param after Bytes que chegaram depois do quadro e ainda não foram lidos.
+ */
+void chainReceive(const uint8_t *frame, int after) {
+  unsigned long delayUs = sysexValue(&frame[4], 3) + (unsigned long)(CHAIN_FRAME_LEN + after) * CHAIN_BYTE_US;
+  padTime_t time = padNow() - PAD_TIME(delayUs);
+  if (frame[7]) { // Toque na outra placa: fonte de crosstalk (@ref CROSSTALK_LOGIC)
+    crosstalkRemotePeak = frame[7] << 3;
+    crosstalkRemoteTick = PAD_TICK(time);
+  }
+#if CHAIN_ROLE == CHAIN_ROLE_MASTER
+  uint8_t pad = (frame[3] == CHAIN_NO_PAD) ? MIDI_NO_PAD : CHAIN_REMOTE_PAD(frame[3]);
+  midiRingPushAt(frame[0], frame[1], frame[2], pad, time);
+#endif
+}
+
+/** @brief Lê os quadros recebidos da outra placa; chamada a cada passagem do `loop()`. */
+void chainPoll() {
+  if (crosstalkRemotePeak && PAD_ELAPSED(PAD_TICK(padNow()), crosstalkRemoteTick) > PAD_TICKS(CROSSTALK_MAX_WINDOW_MS * 1000UL)) {
+    crosstalkRemotePeak = 0; // Toque antigo: não é mais fonte de vazamento
+  }
+  for (int available = CHAIN_PORT.available(); available > 0; available--) {
+    uint8_t b = CHAIN_PORT.read();
+    if (b & 0x80) chainFrameLength = 0; // Status: início de um quadro
+    else if (chainFrameLength == 0) continue; // Dado sem status: byte perdido antes, descarta
+    chainFrame[chainFrameLength++] = b;
+    if (chainFrameLength == CHAIN_FRAME_LEN) {
+      chainFrameLength = 0;
+      chainReceive(chainFrame, available - 1);
+    }
+  }
+}
+#endif
+/** @} */
+
+/**
+ * @defgroup HIHAT_PEDAL Pedal do Chimbal
+ * @brief Posição do pedal, articulação do chimbal e controlador contínuo CC4.
+ * @details pedalService() roda a cada passagem do `loop()` e mantém `pedalPosition`
+ * (0 = solto a 127 = fechado), que o toque do chimbal consulta para escolher entre as
+ * notas fechada, semiaberta e aberta (pedalHihatNote()).
+ *
+ * Com a chave digital, a posição só vale 0 ou 127, e cada mudança envia as mesmas notas
+ * de antes (som do pedal ao fechar, corte do som aberto/fechado).
+ *
+ * Com o pedal contínuo (@ref PEDAL_CHIMBAL_ANALOG), a leitura filtrada pela varredura é
+ * mapeada de `PEDAL_RAW_OPEN`-`PEDAL_RAW_CLOSED` para 0-127 e transmitida como CC4
+ * (foot controller). Para não saturar a linha de 31250 bauds junto com as notas, um CC só
+ * sai se:
+ * - já passaram `PEDAL_CC_INTERVAL_US` desde o anterior;
+ * - a posição mudou pelo menos `PEDAL_CC_DELTA`, ou chegou a um extremo, ou ficou parada
+ *   `PEDAL_CC_SETTLE_US` (assim o valor final sempre é enviado);
+ * - a fila de baixa prioridade da saída está com pelo menos metade livre.
+ *
+ * Antes da nota de um toque no chimbal, a posição em uso é enviada mesmo fora desses
+ * limites, para que o sintetizador escolha a amostra com o CC4 atualizado.
+ * @{
+ */
+#define MIDI_CC_FOOT_CONTROLLER 4 /**< Número do controlador do pedal do chimbal. */
+#define PEDAL_POSITION_CLOSED 127 /**< `pedalPosition` com o pedal totalmente fechado. */
+
+const uint8_t PEDAL_CLOSED_LEVEL = 100;   /**< Posição a partir da qual o chimbal soa fechado. */
+const uint8_t PEDAL_HALF_LEVEL = 40;      /**< Posição a partir da qual o chimbal soa semiaberto. */
+const uint8_t PEDAL_HYSTERESIS = 4;       /**< Histerese ao sair do fechado, contra oscilações na fronteira. */
+const uint8_t PEDAL_CHICK_VELOCITY = 30;  /**< Velocidade da nota do pedal ao fechar o chimbal. */
+
+#if PEDAL_CHIMBAL_ANALOG
+/** @brief Leitura filtrada com o pedal solto (calibração do sensor). */
+#ifndef PEDAL_RAW_OPEN
+#define PEDAL_RAW_OPEN 100
+#endif
+/** @brief Leitura filtrada com o pedal fechado (pode ser menor que `PEDAL_RAW_OPEN`). */
+#ifndef PEDAL_RAW_CLOSED
+#define PEDAL_RAW_CLOSED 900
+#endif
+
+const padTime_t PEDAL_CC_INTERVAL_US = 10000; /**< Intervalo mínimo entre dois CC4 (no máximo 100 por segundo). */
+const padTime_t PEDAL_CC_SETTLE_US = 50000;   /**< Tempo parado após o qual mudanças menores que `PEDAL_CC_DELTA` são enviadas. */
+const uint8_t PEDAL_CC_DELTA = 2;             /**< Menor mudança de posição enviada antes de o pedal parar. */
+
+uint8_t pedalSentPosition = 0;  /**< Último valor de CC4 enviado. */
+padTime_t pedalSentTime = 0;    /**< Instante do último CC4 enviado. */
+#endif
+
+bool pedalClosed = false; /**< Chimbal fechado (com histerese), para as notas de transição. */
+
+/** @brief Nota do toque do chimbal conforme a posição atual do pedal. */
+int pedalHihatNote() {
+  if (pedalPosition >= PEDAL_CLOSED_LEVEL) return MIDI_NOTE_CHIMBAL_CLOSED;
+  if (pedalPosition >= PEDAL_HALF_LEVEL) return MIDI_NOTE_CHIMBAL_HALF;
+  return MIDI_NOTE_CHIMBAL_OPEN;
+}
+
+/**
+ * @brief Envia as notas de transição quando o chimbal fecha ou abre.
+ * @details Ao fechar, corta o som aberto/semiaberto e toca o som do pedal; ao abrir,
+ * corta o som fechado.
+ */
+void pedalUpdateClosed() {
+  bool closed = pedalPosition >= (pedalClosed ? PEDAL_CLOSED_LEVEL - PEDAL_HYSTERESIS : PEDAL_CLOSED_LEVEL);
+  if (closed == pedalClosed) return;
+  pedalClosed = closed;
+  if (closed) { // Pedal pressionado (Fechado)
+    if (voicePlaying(MIDI_NOTE_CHIMBAL_OPEN)) midiNoteOff(MIDI_NOTE_CHIMBAL_OPEN, 0);
+    if (voicePlaying(MIDI_NOTE_CHIMBAL_HALF)) midiNoteOff(MIDI_NOTE_CHIMBAL_HALF, 0);
+    midiNoteOn(MIDI_NOTE_CHIMBAL_PEDAL, PEDAL_CHICK_VELOCITY);
+  } else { // Pedal Solto (Aberto)
+    if (voicePlaying(MIDI_NOTE_CHIMBAL_CLOSED)) midiNoteOff(MIDI_NOTE_CHIMBAL_CLOSED, 0);
+  }
+}
+
+/**
+ * @brief Envia a posição atual como CC4, se ela ainda não foi enviada.
+ * @param now Instante atual.
+ * @param pad Peça cujo toque depende da posição: o CC sai já, antes do note-on do toque,
+ *        ignorando o intervalo, a mudança mínima e a folga da fila. `MIDI_NO_PAD` no
+ *        envio periódico.
+ */
+void pedalSendPosition(padTime_t now, uint8_t pad) {
+#if PEDAL_CHIMBAL_ANALOG
+  uint8_t position = pedalPosition;
+  if (position == pedalSentPosition) return;
+  if (pad == MIDI_NO_PAD) {
+    padTime_t since = now - pedalSentTime;
+    uint8_t delta = position > pedalSentPosition ? position - pedalSentPosition : pedalSentPosition - position;
+    bool extreme = position == 0 || position == PEDAL_POSITION_CLOSED;
+    if (since < PEDAL_CC_INTERVAL_US) return;
+    if (delta < PEDAL_CC_DELTA && !extreme && since < PEDAL_CC_SETTLE_US) return;
+    if (midiQueueFree(MIDI_QUEUE_OTHER) < MIDI_OTHER_CAPACITY / 2) return;
+  }
+  if (midiRingPush(0xB0, MIDI_CC_FOOT_CONTROLLER, position, pad)) {
+    pedalSentPosition = position;
+    pedalSentTime = now;
+  }
+#else
+  (void)now; (void)pad;
+#endif
+}
+
+/**
+ * @brief Lê o pedal, atualiza `pedalPosition` e envia as mensagens correspondentes.
+ * @param now Instante atual.
+ */
+void pedalService(padTime_t now) {
+#if PEDAL_CHIMBAL_ANALOG
+  long span = (long)PEDAL_RAW_CLOSED - PEDAL_RAW_OPEN;
+  long position = ((long)scanPedal() - PEDAL_RAW_OPEN) * PEDAL_POSITION_CLOSED / span;
+  pedalPosition = (uint8_t)constrain(position, 0L, (long)PEDAL_POSITION_CLOSED);
+  pedalUpdateClosed();
+  pedalSendPosition(now, MIDI_NO_PAD);
+#else
+  (void)now;
+  int currentPedalReading = digitalRead(PEDAL_CHIMBAL_PIN); // Lê o estado do pedal do chimbal
+  if (currentPedalReading != lastPedalChimbalState) {
+    lastPedalChimbalState = currentPedalReading;
+    pedalPosition = (currentPedalReading == LOW) ? PEDAL_POSITION_CLOSED : 0;
+    pedalUpdateClosed();
+  }
+#endif
+}
+/** @} */
+
+/** 
+ * @defgroup INICIALIZACAO Função de inicialização do Arduino.
+ * @brief Configura a comunicação Serial/MIDI, os pinos dos sensores e inicializa
+ * as variáveis de estado de todos os pads.
+ * 
+ * Inclui a função `setup()` e variáveis associadas à etapa inicial.
+ * @{
+ */
+/** @} */
+
+/** 
+ * @defgroup MAIN_LOOP Lógica Principal (loop)
+ * @brief Processamento contínuo dos pads e envio de mensagens MIDI.
+ * @details Este grupo descreve o fluxo principal do firmware que roda no Arduino:
+ * - Lê continuamente os sensores piezoelétricos;
+ * - Aplica máquinas de estado para cada pad;
+ * - Gerencia crosstalk, repiques e choke;
+ * - Lida com o pedal do chimbal e envia as notas MIDI correspondentes.
+ * 
+ * Engloba a função `loop()` e o motor de pads (@ref PAD_ENGINE).
+ * @{
+ */
+/** @} */
+
+/**
+ * @defgroup PAD_ENGINE Motor Unificado dos Pads
+ * @ingroup MAIN_LOOP
+ * @brief Máquina de estados única para todas as peças descritas em `padTable[]`.
+ * @details Peças de uma a `PAD_MAX_ZONES` zonas passam pela mesma máquina de estados;
+ * uma peça de uma zona é apenas o caso particular com `sensor[1] == NO_SENSOR`. A lógica
+ * específica de cada tipo de peça (chimbal, regras de zona) só é consultada quando um
+ * toque é validado, em padEmitHit(), e não a cada amostra.
+ *
+ * @subsection PAD_STATE_IDLE_DOC Estado Ocioso (PAD_STATE_IDLE)
+ * @details Aguarda o início de um toque. Se a leitura de qualquer zona ultrapassar o seu
+ * `threshold`, a peça transiciona para `PAD_STATE_PEAK_DETECTION`.
+ *
+ * @subsection PAD_STATE_PEAK_DETECTION_DOC Estado de Detecção de Pico (PAD_STATE_PEAK_DETECTION)
+ * @details Registra o maior valor de cada zona durante `peakWindowUs` (ou `padWindows.peakDetectionUs`, 7 ms por padrão).
+ * - Se nenhum pico ultrapassar o `threshold` da sua zona, retorna a `IDLE` (falso positivo).
+ * - Caso contrário, calcula as velocidades, aplica a eliminação de crosstalk e envia a
+ * nota conforme o tipo da peça. Transiciona para `PAD_STATE_SILENT_DEBOUNCE`.
+ *
+ * @subsubsection PAD_CROSSTALK_DOC Lógica de Eliminação de Crosstalk
+ * @details Ignora o toque se o seu maior pico (entre as zonas) não passar do vazamento
+ * esperado de um toque recente numa peça acoplada (@ref CROSSTALK_LOGIC). Toques fracos
+ * legítimos em peças distantes, ou acima do vazamento esperado, são mantidos.
+ *
+ * @subsection PAD_STATE_SILENT_DEBOUNCE_DOC Estado de Debounce Silencioso (PAD_STATE_SILENT_DEBOUNCE)
+ * @details Ignora ruídos residuais por `padWindows.silentDebounceUs` (30 ms por padrão), prevenindo múltiplos
+ * disparos de uma única batida. Depois transiciona para `PAD_STATE_REPIQUE_CHECK`.
+ *
+ * @subsection PAD_STATE_REPIQUE_CHECK_DOC Estado de Verificação de Repique (PAD_STATE_REPIQUE_CHECK)
+ * @details Durante `padWindows.repiqueCheckUs` (180 ms por padrão), o limiar de detecção decai em degraus de
+ * PadRuntime::retriggerInitial para o `threshold` normal (@ref RETRIGGER_DECAY). Se a
+ * maior leitura entre as zonas ultrapassar o limiar, um novo toque começa em
+ * `PAD_STATE_PEAK_DETECTION`.
+ *
+ * @subsection PAD_STATE_CHOKE_CONFIRMATION_DOC Estado de Confirmação de Choke (PAD_STATE_CHOKE_CONFIRMATION)
+ * @details Exclusivo de peças com `PAD_FLAG_CHOKE` e uma chave de borda em
+ * PadDescriptor::chokePin. A peça entra neste estado quando a chave é pressionada com a
+ * peça ociosa ou em checagem de repique (durante o pico ou o debounce, ao fim deles).
+ * - Se a chave continuar pressionada por `padWindows.chokeConfirmationUs`, o choke é
+ *   confirmado e as notas do prato são desligadas.
+ * - Se a chave for solta antes disso (repique da chave num toque de borda), a peça volta
+ *   a `IDLE` sem enviar nada.
+ * - Se os sensores passarem do limiar, é um toque que também fechou a chave: a detecção
+ *   de pico começa com as mesmas leituras da varredura. Se a chave ainda estiver
+ *   pressionada ao fim do toque, a confirmação recomeça.
+ *
+ * A latência do choke é, portanto, `chokeConfirmationUs` mais um período do `loop()`
+ * (ou, no máximo, uma janela de pico a mais). Nenhum choke é deduzido dos picos dos
+ * sensores, o que evitava note-offs falsos em toques fracos de cúpula.
+ *
+ * @subsection PAD_KERNEL_DOC Núcleos Especializados (PAD_ENGINE_STATIC)
+ * @details O passo do motor é um modelo sobre um núcleo (`K`) que informa o tipo, o
+ * número de zonas e as flags da peça. `PadKernelTable` lê esses campos de `padConfig[]`
+ * a cada passo: um só código para todas as peças, como no firmware configurável. Com
+ * `PAD_ENGINE_STATIC`, cada peça usa `PadKernelOf<P>`, com os valores de `padTable[P]`
+ * como constantes: os laços por zona têm tamanho fixo, o choke e a posição na pele
+ * somem das peças que não os têm e padEmitHit() só contém a lógica do tipo da peça. O
+ * `loop()` chama uma instância por tipo de núcleo (`SimplePad`, `HiHatPad`,
+ * `SnareRimPad`, `CymbalChokePad` no kit de fábrica), sem nenhuma decisão pela
+ * identidade da peça em tempo de execução.
+ *
+ * Os dois modos leem limiares, ganhos, notas e janelas de `padConfig[]` e continuam
+ * ajustáveis por SysEx (@ref CONFIG); só a estrutura das peças, que a configuração
+ * gravada já não pode mudar, é fixada na compilação. O custo é uma cópia do passo por
+ * tipo de núcleo na flash.
+ * @{
+ */
+
+/**
+ * @brief Núcleo com a estrutura da peça fixada em tempo de compilação.
+ * @tparam Kind Tipo da peça (@ref PadKind).
+ * @tparam Zones Número de zonas.
+ * @tparam Flags Combinação de `PAD_FLAG_*`.
+ */
+template <uint8_t Kind, uint8_t Zones, uint8_t Flags>
+struct PadKernel {
+  static uint8_t kind(const PadDescriptor &) { return Kind; }
+  static uint8_t zones(const PadDescriptor &) { return Zones; }
+  static uint8_t flags(const PadDescriptor &) { return Flags; }
+};
+
+/** @brief Núcleo genérico: a estrutura de cada peça é lida de `padConfig[]`. */
+struct PadKernelTable {
+  static uint8_t kind(const PadDescriptor &d) { return d.kind; }
+  static uint8_t zones(const PadDescriptor &d) { return padZones(d); }
+  static uint8_t flags(const PadDescriptor &d) { return d.flags; }
+};
+
+/** @brief Núcleo da peça `P`, a partir da sua linha em `padTable[]`. */
+template <uint8_t P>
+struct PadKernelOf : PadKernel<padTable[P].kind, padZones(padTable[P]), padTable[P].flags> {};
+
+typedef PadKernel<PAD_KIND_SIMPLE, 1, 0>                SimplePad;      /**< Bumbo, surdo e toms. */
+typedef PadKernel<PAD_KIND_HIHAT, 1, 0>                 HiHatPad;       /**< Chimbal com pedal. */
+typedef PadKernel<PAD_KIND_ZONED, 2, PAD_FLAG_POSITION> SnareRimPad;    /**< Caixa com aro e posição na pele. */
+typedef PadKernel<PAD_KIND_ZONED, 2, PAD_FLAG_CHOKE>    CymbalChokePad; /**< Pratos com cúpula, borda e choke. */
+
+
+/**
+ * @brief Inicia a detecção de pico de uma peça com as leituras atuais.
+ * @param p Índice da peça em `padTable[]`.
+ * @param r Estado da peça.
+ * @param d Descrição da peça.
+ * @param reading Leituras atuais de cada zona.
+ * @param zones Número de zonas da peça.
+ * @param now Instante atual (padTick()).
+ */
+void padStartPeak(uint8_t p, PadRuntime &r, const PadDescriptor &d, const int *reading, uint8_t zones, padTick_t now) {
+  r.crosstalkPeak = 0;
+#if PEAK_TRACKING
+  peakTrackBegin(r);
+#endif
+  for (uint8_t z = 0; z < zones; z++) {
+#if PEAK_TRACKING
+    peakTrackSensor(r, z, d.sensor[z]);
+#else
+    r.peak[z] = reading[z];
+#endif
+    if (reading[z] > r.crosstalkPeak) r.crosstalkPeak = reading[z];
+  }
+  ringOnset(r, d, now); // Vibração do toque anterior neste início (@ref RESIDUAL_ENERGY)
+  r.state = PAD_STATE_PEAK_DETECTION;
+  r.stateTick = now;
+  r.onsetTick = now;
+  profPeakSample(p, scanTakenCount[d.sensor[0]]);
+}
+
+/**
+ * @brief Envia as notas de um toque validado conforme o tipo da peça.
+ * @details Chamada uma única vez por toque: aqui fica toda a lógica que depende da
+ * identidade da peça (articulação do chimbal, zona tocada e posição na pele).
+ * @param p Índice da peça em `padTable[]`.
+ * @param r Estado da peça (picos de cada zona).
+ * @param d Descrição da peça.
+ * @param velocity Velocidade de cada zona.
+ * @tparam K Núcleo da peça (@ref PAD_KERNEL_DOC).
+ */
+template <class K>
+void padEmitHit(uint8_t p, const PadRuntime &r, const PadDescriptor &d, const int *velocity) {
+#if POSITION_SENSING
+  if ((K::flags(d) & PAD_FLAG_POSITION) && !loopDegraded) midiRingPush(0xB0, MIDI_CC_POSITION, headPosition(r, d, velocity), p);
+#endif
+  switch (K::kind(d)) {
+    case PAD_KIND_SIMPLE:
+      midiNoteOn(d.note[0], velocity[0], p);
+      break;
+
+    case PAD_KIND_HIHAT: {
+      /** O Chimbal escolhe a articulação (fechado, semiaberto ou aberto) pela posição do pedal. */
+      static const int hihatNotes[] = { MIDI_NOTE_CHIMBAL_CLOSED, MIDI_NOTE_CHIMBAL_HALF, MIDI_NOTE_CHIMBAL_OPEN };
+      int note = pedalHihatNote();
+      pedalSendPosition(padNow(), p); // O CC4 chega antes da nota
+      midiNoteOn(note, velocity[0], p);
+      for (uint8_t i = 0; i < sizeof(hihatNotes) / sizeof(hihatNotes[0]); i++) {
+        if (hihatNotes[i] != note && voicePlaying(hihatNotes[i])) midiNoteOff(hihatNotes[i], 0, p);
+      }
+      break;
+    }
+
+    case PAD_KIND_ZONED: {
+      /**
+       * Peças de várias zonas (caixa com aro e rimshot, pratos com cúpula e borda): a zona
+       * tocada sai das regras de @ref ZONE_RULES. O choke dos pratos vem da chave de borda,
+       * e não dos picos (@ref PAD_STATE_CHOKE_CONFIRMATION_DOC).
+       */
+      const ZoneRule *rule = zoneClassify(p, d, r.peak);
+      if (!rule) {
+        midiNoteOn(d.note[0], velocity[0], p); // Nenhuma regra: zona principal
+        break;
+      }
+      int note = (rule->note == ZONE_NOTE_OF_ZONE) ? d.note[rule->zone] : rule->note;
+      int zoneVelocity = velocity[rule->zone];
+      if (rule->velocity == ZONE_VELOCITY_MAX) zoneVelocity = max(zoneVelocity, velocity[rule->reference]);
+      midiNoteOn(note, zoneVelocity, p);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Lê a chave de choke de uma peça.
+ * @param d Descrição da peça.
+ * @tparam K Núcleo da peça (@ref PAD_KERNEL_DOC).
+ * @return `true` se a peça aceita choke e a chave está pressionada.
+ */
+template <class K>
+inline bool padChokePressed(const PadDescriptor &d) {
+  return (K::flags(d) & PAD_FLAG_CHOKE) && d.chokePin != NO_PIN && digitalRead(d.chokePin) == LOW;
+}
+
+/**
+ * @brief Executa um passo da máquina de estados de uma peça.
+ * @param p Índice da peça em `padTable[]`.
+ * @param time Instante atual (padNow()).
+ * @tparam K Núcleo da peça (@ref PAD_KERNEL_DOC).
+ */
+template <class K>
+void padEngineStep(uint8_t p, padTime_t time) {
+  const PadDescriptor &d = padConfig[p];
+  PadRuntime &r = padRuntime[p];
+  padTick_t now = PAD_TICK(time);
+  uint8_t zones = K::zones(d);
+
+  bool chokePressed = padChokePressed<K>(d);
+  if (!chokePressed) {
+    r.chokeHeld = 0;
+  } else if (!r.chokeHeld && (r.state == PAD_STATE_IDLE || r.state == PAD_STATE_REPIQUE_CHECK)) {
+    // Chave fechou: confirma sem bloquear. Vindo do repique, o limiar atual é mantido
+    // para que a vibração residual do toque anterior não seja tomada por um novo toque.
+    if (r.state == PAD_STATE_IDLE) r.retriggerLevel = 0;
+    r.state = PAD_STATE_CHOKE_CONFIRMATION;
+    r.stateTick = now;
+  }
+
+  int reading[PAD_MAX_ZONES] = {0};
+  int strongest = 0;
+  bool aboveThreshold = false;
+  for (uint8_t z = 0; z < zones; z++) {
+    reading[z] = scanTake(d.sensor[z]);
+    if (reading[z] > padThreshold(d, z)) aboveThreshold = true;
+    if (reading[z] > strongest) strongest = reading[z];
+  }
+
+  switch (r.state) {
+    case PAD_STATE_IDLE:
+      if (aboveThreshold) {
+        padStartPeak(p, r, d, reading, zones, now);
+        break;
+      }
+      if (!loopDegraded) { // Só ruído: atualiza o limiar (@ref NOISE_FLOOR), exceto em sobrecarga (@ref LOOP_BUDGET)
+        for (uint8_t z = 0; z < zones; z++) noiseTrack(d, z, reading[z]);
+      }
+      if (r.crosstalkPeak && PAD_ELAPSED(now, r.onsetTick) > PAD_TICKS(CROSSTALK_MAX_WINDOW_MS * 1000UL)) {
+        r.crosstalkPeak = 0; // Toque antigo: não é mais fonte de vazamento
+      }
+      ringExpire(r, d, now);
+      break;
+
+    case PAD_STATE_PEAK_DETECTION: {
+      // Continua buscando o pico dentro da janela
+      bool windowOpen = PAD_ELAPSED(now, r.stateTick) < PAD_TICKS((padTime_t)(d.peakWindowUs ? d.peakWindowUs : padWindows.peakDetectionUs));
+      if (windowOpen) {
+        profPeakSample(p, scanTakenCount[d.sensor[0]]);
+        for (uint8_t z = 0; z < zones; z++) {
+#if PEAK_TRACKING
+          peakTrackSensor(r, z, d.sensor[z]);
+#else
+          if (reading[z] > r.peak[z]) r.peak[z] = reading[z];
+#endif
+        }
+        if (strongest > r.crosstalkPeak) r.crosstalkPeak = strongest; // Visível às outras peças já durante a janela
+#if PEAK_TRACKING
+        windowOpen = !peakSettled(r, d, zones); // O sinal já caiu em todas as zonas
+#endif
+      }
+      if (!windowOpen) {
+        // Janela de detecção de pico encerrou.
+        profPeakWindowEnd(p);
+        int velocity[PAD_MAX_ZONES] = {0};
+        int strongestPeak = 0;
+        bool validated = false;
+        for (uint8_t z = 0; z < zones; z++) {
+#if PEAK_TRACKING
+          r.peak[z] = peakEstimate(r, z);
+#endif
+          int peak = r.peak[z];
+          if (peak > padThreshold(d, z)) validated = true;
+          if (peak > strongestPeak) strongestPeak = peak;
+        }
+        uint16_t keep = ringKeepQ8(r, strongestPeak); // Sem a vibração do toque anterior (@ref RESIDUAL_ENERGY)
+        for (uint8_t z = 0; z < zones; z++) velocity[z] = velocityLookup(d.sensor[z], ((uint32_t)r.peak[z] * keep) >> 8);
+
+        if (!validated) {
+          r.state = PAD_STATE_IDLE;
+        } else if (crosstalkSuspect(p, strongestPeak, now)) {
+          // Não passa do vazamento esperado de uma peça acoplada, ignora
+          profCrosstalk(p);
+          r.state = PAD_STATE_IDLE;
+        } else {
+          padEmitHit<K>(p, r, d, velocity);
+#if CHAIN_ROLE == CHAIN_ROLE_MASTER
+          chainSendHit(p, d, velocity[0]); // Para o crosstalk na placa secundária
+#endif
+          r.ringLevel = d.ringHalfLifeMs ? strongestPeak : 0; // Referência para o próximo toque
+
+          // Transiciona para o debounce silencioso após disparar a nota
+          r.state = PAD_STATE_SILENT_DEBOUNCE;
+          r.stateTick = now;
+
+          // Armazena o valor inicial do retrigger para o decaimento
+          r.retriggerInitial = max((int)((padThreshold(d, 0) * RETRIGGER_MIN_MULTIPLIER_Q8) >> 8),
+              min(d.retrigger, (int)((strongestPeak * RETRIGGER_MIN_MULTIPLIER_Q8) >> 8)));
+        }
+      }
+      break;
+    }
+
+    case PAD_STATE_SILENT_DEBOUNCE:
+      if (PAD_ELAPSED(now, r.stateTick) >= PAD_TICKS(padWindows.silentDebounceUs)) {
+        r.state = PAD_STATE_REPIQUE_CHECK;
+        r.stateTick = now;
+        retriggerDecayStart(r, d);
+      }
+      break;
+
+    case PAD_STATE_REPIQUE_CHECK: {
+      padTick_t elapsedTime = PAD_ELAPSED(now, r.stateTick);
+      if (elapsedTime >= PAD_TICKS(padWindows.repiqueCheckUs)) {
+        r.state = PAD_STATE_IDLE;
+      } else {
+        if (elapsedTime >= r.retriggerNextTick) {
+          retriggerDecayAdvance(r, d);
+        }
+
+        // Se houver repique, o estado muda para peak_detection
+        if (strongest > r.retriggerLevel) {
+          padStartPeak(p, r, d, reading, zones, now);
+        }
+      }
+      break;
+    }
+
+    case PAD_STATE_CHOKE_CONFIRMATION:
+      if (!chokePressed) {
+        r.state = PAD_STATE_IDLE; // Solta antes do tempo: repique da chave, não é choke
+      } else if (aboveThreshold && strongest > r.retriggerLevel) {
+        padStartPeak(p, r, d, reading, zones, now); // Um toque fechou a chave
+      } else if (PAD_ELAPSED(now, r.stateTick) >= PAD_TICKS(padWindows.chokeConfirmationUs)) {
+        // Choke confirmado: Enviar MIDI Note Offs para as notas deste prato
+        for (uint8_t z = 0; z < zones; z++) midiNoteOff(d.note[z], 0, p);
+        r.chokeHeld = 1;
+        r.state = PAD_STATE_IDLE;
+      }
+      break;
+  }
+}
+
+/**
+ * @brief Passo do motor de todas as peças a partir de `P`, com o núcleo de cada uma.
+ * @details Percorre `padTable[]` em tempo de compilação (@ref PAD_KERNEL_DOC): cada peça
+ * chama a instância do seu núcleo, sem laço nem escolha em tempo de execução.
+ */
+template <uint8_t P, bool End = (P == NUM_KIT_PADS)>
+struct PadKit {
+  static void step() {
+    uint8_t state = padRuntime[P].state;
+    uint32_t start = profStepBegin();
+    padEngineStep<PadKernelOf<P> >(P, padNow());
+    profStepEnd(state, start);
+    PadKit<P + 1>::step();
+  }
+};
+
+/** @brief Fim da lista de peças. */
+template <uint8_t P>
+struct PadKit<P, true> {
+  static void step() {}
+};
+
+#if SCAN_SCHEDULING
+/**
+ * @brief Atualiza a agenda da varredura conforme o estado das peças (@ref SCAN_ENGINE).
+ * @details Os sensores de peças em `PAD_STATE_SILENT_DEBOUNCE` saem da agenda e os das
+ * peças em `PAD_STATE_PEAK_DETECTION` recebem as conversões liberadas. Na calibração e na
+ * captura, que esperam todos os sensores em ordem, a agenda volta a ser uniforme. Só
+ * remonta a agenda quando o uso de algum sensor muda.
+ */
+void padScheduleUpdate() {
+  uint8_t cls[SCAN_CHANNELS];
+  memset(cls, SCAN_CLASS_NORMAL, sizeof(cls));
+  bool uniform = calibrationActive;
+#if CAPTURE_ENABLED
+  if (captureState != CAPTURE_OFF) uniform = true;
+#endif
+  for (uint8_t p = 0; p < NUM_KIT_PADS && !uniform; p++) {
+    uint8_t state = padRuntime[p].state;
+    if (state != PAD_STATE_SILENT_DEBOUNCE && state != PAD_STATE_PEAK_DETECTION) continue;
+    const PadDescriptor &d = padConfig[p];
+    for (uint8_t z = 0; z < padZones(d); z++) {
+      cls[d.sensor[z]] = (state == PAD_STATE_PEAK_DETECTION) ? SCAN_CLASS_BOOST : SCAN_CLASS_SKIP;
+    }
+  }
+  if (memcmp(cls, scanClass, sizeof(cls))) scanScheduleSet(cls);
+}
+#endif
+/** @} */
+
+/** @ingroup INICIALIZACAO */
+void setup() {
+  midiBegin(); // Inicializa a porta do transporte MIDI
+  voiceBegin();
+  kitLoaded(configBegin() ? KIT_PROFILE_USER : KIT_PROFILE_FACTORY); // Valores de fábrica, substituídos pelos da EEPROM se válidos
+  noiseBegin();
+
+  for (int i = 0; i < NUM_PADS; i++) {
+    if (!MUX_IS_INPUT(piezoPin[i])) pinMode(piezoPin[i], INPUT);
+  }
+  memset(padRuntime, 0, sizeof(padRuntime)); // Todas as peças em PAD_STATE_IDLE
+
+#if PEDAL_CHIMBAL_ANALOG
+  if (!MUX_IS_INPUT(PEDAL_CHIMBAL_ANALOG_PIN)) pinMode(PEDAL_CHIMBAL_ANALOG_PIN, INPUT);
+#else
+  pinMode(PEDAL_CHIMBAL_PIN, INPUT_PULLUP);
+#endif
+  if (KIT_FOOTSWITCH_PIN != NO_PIN) pinMode(KIT_FOOTSWITCH_PIN, INPUT_PULLUP);
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    if (padConfig[p].chokePin != NO_PIN) pinMode(padConfig[p].chokePin, INPUT_PULLUP);
+  }
+  velocityLutBegin(); // Gera as tabelas pico -> velocidade
+  scanBegin(); // Inicia a varredura dos sensores por interrupção
+  profBegin();
+  loopBudgetBegin();
+}
+
+/** @ingroup MAIN_LOOP */
+void loop() {
+  profLoopStart();
+  loopBudgetStart(); // Estouro do orçamento: modo degradado (@ref LOOP_BUDGET)
+  sysexReplyService(); // Resposta SysEx pendente, no espaço livre da porta
+  sysexPoll(); // Comandos SysEx recebidos (consultas, configuração)
+#if CHAIN_ROLE != CHAIN_ROLE_NONE
+  chainPoll(); // Quadros da outra placa (@ref CHAIN)
+#endif
+#if SCAN_SCHEDULING
+  padScheduleUpdate(); // Conversões da varredura conforme o estado das peças
+#endif
+#if CAPTURE_ENABLED
+  if (captureState != CAPTURE_OFF) { // Captura bruta: só envia as amostras (@ref CAPTURE)
+    captureService();
+    return;
+  }
+#endif
+  if (calibrationActive) { // Modo de calibração: só captura os picos (@ref CALIBRATION)
+    calibrationStep(padNow());
+    voiceService(padNow());
+    midiTransmit();
+    return;
+  }
+
+  kitService(padNow()); // Troca de perfil em andamento, uma peça por passagem (@ref KIT_PROFILES)
+
+  // --- Processamento do Pedal do Chimbal (@ref HIHAT_PEDAL) ---
+  pedalService(padNow());
+
+  // --- Motor de pads: um passo da máquina de estados por peça ---
+#if PAD_ENGINE_STATIC
+  PadKit<0>::step();
+#else
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    uint8_t state = padRuntime[p].state;
+    uint32_t start = profStepBegin();
+    padEngineStep<PadKernelTable>(p, padNow());
+    profStepEnd(state, start);
+  }
+#endif
+
+  voiceService(padNow()); // Note-offs agendados que venceram
+  midiTransmit(); // Envia os eventos pendentes sem bloquear a varredura
+} // Fim do void loop()
+
+/**
+ * @brief Empilha uma mensagem MIDI Note On na fila de saída (enviada por midiTransmit()).
+ * @param note O número da nota MIDI (0-127).
+ * @param velocity A velocidade da nota (0-127).
+ * @param pad Peça de origem em `padTable[]`, ou `MIDI_NO_PAD`.
+ * @return `false` se a fila estava cheia e a nota foi descartada (contada em `midiOverflowCount`).
+ * @note Também ocupa uma voz e agenda o note-off automático (@ref VOICES), só se a nota
+ *       couber na fila.
+ */
+bool midiNoteOn(int note, int velocity, uint8_t pad) {
+  byte channel = 0;
+  if (midiQueueFree(velocity > 0 ? MIDI_QUEUE_NOTE_ON : MIDI_QUEUE_OTHER) == 0 || !voiceStart((byte)note, pad)) {
+    midiOverflowCount++;
+    return false;
+  }
+  return midiRingPush(0x90 | channel, (byte)note, (byte)velocity, pad);
 }
 
 /**
- * @brief Envia uma mensagem MIDI Note Off pela porta Serial.
+ * @brief Empilha uma mensagem MIDI Note Off na fila de saída (enviada por midiTransmit()).
  * @param note O número da nota MIDI (0-127) a ser desligada.
  * @param velocity A velocidade de "release" da nota (geralmente 0).
- * @note Também atualiza as flags globais de estado `...Playing` para o controle de choke.
+ * @param pad Peça de origem em `padTable[]`, ou `MIDI_NO_PAD`.
+ * @return `false` se a fila estava cheia; a voz da nota continua e o note-off agendado
+ *         sai numa passagem seguinte.
+ * @note Também libera a voz da nota, cancelando o note-off agendado (@ref VOICES).
  */
-void midiNoteOff(int note, int velocity) {
+bool midiNoteOff(int note, int velocity, uint8_t pad) {
   byte channel = 0;
-  Serial.write(0x80 | channel);
-  Serial.write((byte)note);
-  Serial.write((byte)velocity);
-
-  // Atualiza flags de notas parando de tocar
-  if (note == midiNote[CONDUCAO_BORDA_PAD]) conducaoBordaPlaying = false;
-  else if (note == midiNote[CONDUCAO_CUPULA_PAD]) conducaoCupulaPlaying = false;
-  else if (note == midiNote[ATAQUE_BORDA_PAD]) ataqueBordaPlaying = false;
-  else if (note == midiNote[ATAQUE_CUPULA_PAD]) ataqueCupulaPlaying = false;
-  else if (note == midiNote[CAIXA_PAD]) caixaPlaying = false;
-  else if (note == midiNote[ARO_CAIXA_PAD]) aroCaixaPlaying = false;
-  else if (note == MIDI_NOTE_CHIMBAL_CLOSED) chimbalClosedSoundPlaying = false;
-  else if (note == MIDI_NOTE_CHIMBAL_OPEN) chimbalOpenSoundPlaying = false;
+  if (!midiRingPush(0x80 | channel, (byte)note, (byte)velocity, pad)) return false;
+  voiceRelease((byte)note);
+  return true;
 }
\ No newline at end of file
@@ -0,0 +1,428 @@
+/**
+ * @file bench.cpp
+ * @brief Bancada de medição: qualidade de disparo e custo por passo do motor de pads.
+ * @details Gera um traço sintético rotulado (toques com amplitude, vazamento entre
+ * sensores e ruído conhecidos, e chokes nos pratos) e o reproduz no firmware para cada combinação de taxa de
+ * amostragem e janelas da máquina de estados. Cada combinação roda num processo filho,
+ * com o firmware no estado inicial, e produz uma linha de uma tabela separada por tabs:
+ *
+ * | Coluna | Conteúdo |
+ * |--------|----------|
+ * | `trace` | `synthetic` ou o nome do arquivo rotulado |
+ * | `rate_hz`, `peak_us`, `debounce_us`, `repique_us` | configuração da linha |
+ * | `hits` | toques rotulados |
+ * | `detect_rate` | toques com nota certa em até 30 ms |
+ * | `double_rate` | notas extras atribuídas a um toque já detectado, por toque |
+ * | `xtalk_rate` | notas sem toque correspondente (crosstalk), por toque |
+ * | `vel_mae`, `vel_max` | erro absoluto de velocidade, médio e máximo |
+ * | `lat_mean_us`, `lat_max_us` | início do toque → fim da transmissão da nota |
+ * | `cost_idle` ... `cost_choke` | custo médio de padEngineStep() por estado (ciclos do computador) |
+ *
+ * Um em cada `BENCH_CHOKE_EVERY` toques de prato é abafado: a chave de choke fica apertada
+ * depois que o sinal acaba e antes do toque seguinte na mesma peça, o que exercita
+ * `PAD_STATE_CHOKE_CONFIRMATION` (`cost_choke`). Como no kit, o choke encerra a checagem
+ * de repique do prato, e o toque seguinte nele já enfrenta só o limiar.
+ *
+ * A velocidade esperada de cada toque é a que velocityLookup() daria para o pico real
+ * do sinal, de modo que `vel_mae` mede só o erro da amostragem e da janela de pico. Os
+ * custos vêm da instrumentação (@ref PROFILING) com o contador de ciclos do computador:
+ * servem para comparar versões do firmware entre si, não como ciclos do AVR (estes são
+ * lidos no hardware pelo SysEx de instrumentação).
+ *
+ * Compilação e uso (a partir de `doxygen_1.0/sim`):
+ * @code
+ * g++ -std=c++11 -O2 -o bench bench.cpp
+ * ./bench > base.tsv
+ * ./bench -r 10000 -w 3000,7000 -d 30000 -k 180000 -n 1000 -s 7
+ * ./bench -f 10000 gravacao_rotulada.txt
+ * @endcode
+ * - `-r`, `-w`, `-d`, `-k`: listas (separadas por vírgula) de taxas de amostragem (Hz),
+ *   janelas de pico, de debounce e de repique (µs) a combinar;
+ * - `-n`: toques no traço sintético; `-s`: semente do gerador;
+ * - `-l`: intervalo entre chamadas do `loop()` (µs);
+ * - `-z`: zumbido de 60 Hz (retificado) em todos os sensores, com amplitude subindo de 0
+ *   até este valor ao longo do traço sintético, como a deriva do ruído num palco
+ *   (compare com `-DNOISE_TRACKING=1`);
+ * - `-f`: taxa de amostragem dos traços em arquivo (os arquivos substituem o sintético).
+ */
+#define PROFILING_ENABLED 1
+#define SIM_HOST_CYCLES 1
+
+#include "../main.c"
+#include "sim_trace.h"
+
+#include <math.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+#error "A bancada modela apenas os transportes seriais (MIDI_TRANSPORT_SERIAL ou MIDI_TRANSPORT_DIN)."
+#endif
+
+#define BENCH_MATCH_WINDOW_US  30000UL  /**< Atraso máximo entre o toque e a sua nota. */
+#define BENCH_DOUBLE_WINDOW_US 300000UL /**< Notas repetidas após um toque até aqui contam como toque duplo. */
+#define BENCH_BLEED_DELAY_US   400      /**< Atraso do vazamento mecânico entre peças. */
+#define BENCH_REPEAT_MIN_US    100000UL /**< Menor intervalo entre dois toques na mesma peça. */
+#define BENCH_CHOKE_EVERY      4        /**< Um em cada tantos toques de prato é abafado. */
+#define BENCH_CHOKE_DELAY_US   70000UL  /**< Do toque ao aperto da chave (o sinal do prato dura ~64 ms). */
+#define BENCH_CHOKE_HOLD_US    25000UL  /**< Tempo com a chave apertada (mais que `CHOKE_CONFIRMATION_TIME_US`). */
+static_assert(BENCH_CHOKE_DELAY_US + BENCH_CHOKE_HOLD_US < BENCH_REPEAT_MIN_US, "A chave deve ser solta antes do toque seguinte no prato");
+
+/** @brief Como um toque em cada peça aparece nos sensores. */
+struct BenchPiece {
+  uint8_t sensor;      /**< Sensor principal. */
+  uint8_t note;        /**< Nota esperada. */
+  uint8_t zone;        /**< Segundo sensor excitado pelo toque, ou `NO_SENSOR`. */
+  float zoneRatio;     /**< Amplitude no segundo sensor, relativa ao principal. */
+  float decayMs;       /**< Constante de decaimento do sinal. */
+};
+
+/** @brief Peças tocadas no traço sintético (chimbal com o pedal solto: som aberto). */
+static const BenchPiece benchPieces[] = {
+  { BUMBO_PAD,          MIDI_NOTE_BUMBO,          NO_SENSOR,           0.0f,  5.0f },
+  { SURDO_PAD,          MIDI_NOTE_SURDO,          NO_SENSOR,           0.0f,  5.0f },
+  { TOM1_PAD,           MIDI_NOTE_TOM1,           NO_SENSOR,           0.0f,  4.0f },
+  { TOM2_PAD,           MIDI_NOTE_TOM2,           NO_SENSOR,           0.0f,  4.0f },
+  { CHIMBAL_PAD,        MIDI_NOTE_CHIMBAL_OPEN,   NO_SENSOR,           0.0f,  6.0f },
+  { CAIXA_PAD,          MIDI_NOTE_CAIXA,          ARO_CAIXA_PAD,       0.3f,  3.0f },
+  { CONDUCAO_BORDA_PAD, MIDI_NOTE_CONDUCAO_BORDA, CONDUCAO_CUPULA_PAD, 0.25f, 8.0f },
+  { ATAQUE_BORDA_PAD,   MIDI_NOTE_ATAQUE_BORDA,   ATAQUE_CUPULA_PAD,   0.25f, 8.0f }
+};
+#define BENCH_NUM_PIECES (sizeof(benchPieces) / sizeof(benchPieces[0]))
+
+/** @brief Vazamento mecânico padrão entre sensores de peças diferentes. */
+#define BENCH_BLEED_DEFAULT 0.04f
+
+/** @brief Vazamentos maiores que o padrão: peças vizinhas no rack e o bumbo. */
+static const struct { uint8_t from, to; float ratio; } benchBleed[] = {
+  { BUMBO_PAD, SURDO_PAD, 0.10f }, { BUMBO_PAD, CAIXA_PAD, 0.10f }, { BUMBO_PAD, TOM1_PAD, 0.08f },
+  { TOM1_PAD, TOM2_PAD, 0.15f },   { TOM2_PAD, TOM1_PAD, 0.15f },
+  { CAIXA_PAD, TOM1_PAD, 0.12f },  { TOM1_PAD, CAIXA_PAD, 0.12f },
+  { CAIXA_PAD, CHIMBAL_PAD, 0.10f }, { CHIMBAL_PAD, CAIXA_PAD, 0.08f },
+  { TOM2_PAD, CONDUCAO_BORDA_PAD, 0.10f }, { SURDO_PAD, CONDUCAO_BORDA_PAD, 0.08f },
+  { TOM1_PAD, ATAQUE_BORDA_PAD, 0.10f }
+};
+
+/** @brief Toque do traço sintético, antes da amostragem. */
+struct BenchHit {
+  uint64_t timeUs;   /**< Início do toque. */
+  uint8_t piece;     /**< Índice em `benchPieces[]`. */
+  float amplitude;   /**< Amplitude do envelope no sensor principal (unidades do ADC). */
+  bool choke;        /**< O prato é abafado depois do toque. */
+};
+
+/** @brief Configuração de uma linha da tabela. */
+struct BenchConfig {
+  unsigned long rateHz, peakUs, debounceUs, repiqueUs;
+};
+
+static unsigned long benchLoopPeriodUs = 250;
+/** @brief Amplitude final do zumbido somado ao traço sintético (`-z`). */
+static float benchHumAmplitude = 0;
+
+/** @brief Gerador pseudoaleatório reproduzível (xorshift32). */
+static uint32_t benchRandomState = 1;
+static uint32_t benchRandom() {
+  benchRandomState ^= benchRandomState << 13;
+  benchRandomState ^= benchRandomState >> 17;
+  benchRandomState ^= benchRandomState << 5;
+  return benchRandomState;
+}
+static float benchUniform(float lo, float hi) {
+  return lo + (hi - lo) * (benchRandom() & 0xFFFFFF) / (float)0x1000000;
+}
+
+/** @brief Forma do sinal de um piezo: senoide retificada com decaimento exponencial. */
+static float benchEnvelope(float amplitude, float decayMs, float tMs) {
+  if (tMs < 0) return 0;
+  return amplitude * expf(-tMs / decayMs) * fabsf(sinf(2.0f * 3.14159265f * tMs / 1.2f));
+}
+
+/** @brief Peça de `padTable[]` cujo sensor principal é `sensor`, ou `NUM_KIT_PADS`. */
+static uint8_t benchPad(uint8_t sensor) {
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    if (pgm_read_byte(&padTable[p].sensor[0]) == sensor) return p;
+  }
+  return NUM_KIT_PADS;
+}
+
+/** @brief Limiar do sensor principal de uma peça do traço. */
+static int benchThreshold(uint8_t sensor) {
+  uint8_t p = benchPad(sensor);
+  if (p == NUM_KIT_PADS) return 0;
+  PadDescriptor d;
+  memcpy_P(&d, &padTable[p], sizeof(d));
+  return d.threshold[0];
+}
+
+/** @brief Indica se a peça do traço com sensor principal `sensor` aceita choke. */
+static bool benchChokes(uint8_t sensor) {
+  uint8_t p = benchPad(sensor);
+  return p < NUM_KIT_PADS && (pgm_read_byte(&padTable[p].flags) & PAD_FLAG_CHOKE) &&
+         pgm_read_byte(&padTable[p].chokePin) != NO_PIN;
+}
+
+/**
+ * @brief Sorteia os toques do traço sintético.
+ * @details Intervalos de 40 a 160 ms, peça aleatória (sem repetir a mesma peça em menos
+ * de 100 ms), 25% de toques fracos (1,5 a 3 vezes o limiar) e o resto até o fundo de escala.
+ * Os chokes são escolhidos pela contagem dos toques de prato, sem sortear: o traço dos
+ * toques é o mesmo com ou sem eles.
+ */
+static std::vector<BenchHit> benchGenerateHits(unsigned count) {
+  std::vector<BenchHit> hits;
+  uint64_t lastOnPiece[BENCH_NUM_PIECES] = { 0 };
+  uint64_t t = 200000;
+  unsigned cymbalHits = 0;
+  while (hits.size() < count) {
+    t += (uint64_t)benchUniform(40000, 160000);
+    uint8_t piece = benchRandom() % BENCH_NUM_PIECES;
+    if (lastOnPiece[piece] && t - lastOnPiece[piece] < BENCH_REPEAT_MIN_US) continue;
+    lastOnPiece[piece] = t;
+    int threshold = benchThreshold(benchPieces[piece].sensor);
+    float amplitude = (benchRandom() % 4 == 0) ? benchUniform(1.5f, 3.0f) * threshold : benchUniform(150, 1100);
+    bool choke = benchChokes(benchPieces[piece].sensor) && ++cymbalHits % BENCH_CHOKE_EVERY == 0;
+    BenchHit hit = { t, piece, amplitude, choke };
+    hits.push_back(hit);
+  }
+  return hits;
+}
+
+/** @brief Coeficiente de vazamento do sensor `from` para o sensor `to`. */
+static float benchBleedRatio(uint8_t from, uint8_t to) {
+  for (size_t i = 0; i < sizeof(benchBleed) / sizeof(benchBleed[0]); i++) {
+    if (benchBleed[i].from == from && benchBleed[i].to == to) return benchBleed[i].ratio;
+  }
+  return BENCH_BLEED_DEFAULT;
+}
+
+/**
+ * @brief Amostra os toques na taxa dada e rotula cada um com a velocidade esperada.
+ * @details Como no ADC real, cada sensor é amostrado com uma defasagem de
+ * `1 / (taxa * NUM_PADS)` em relação ao anterior. Requer as tabelas de velocidade prontas.
+ */
+static void benchRender(const std::vector<BenchHit> &hits, unsigned long rateHz,
+                        std::vector<SimFrame> &frames, std::vector<SimLabel> &labels) {
+  uint64_t endUs = hits.empty() ? 0 : hits.back().timeUs + 300000;
+  size_t frameCount = endUs * rateHz / 1000000ULL;
+  std::vector<float> signal(frameCount * NUM_PADS, 0.0f);
+  const float frameMs = 1000.0f / rateHz;
+
+  for (size_t h = 0; h < hits.size(); h++) {
+    const BenchHit &hit = hits[h];
+    const BenchPiece &piece = benchPieces[hit.piece];
+    for (uint8_t sensor = 0; sensor < NUM_PADS; sensor++) {
+      float ratio = 1.0f;
+      float delayMs = 0;
+      if (sensor == piece.zone) {
+        ratio = piece.zoneRatio;
+      } else if (sensor != piece.sensor) {
+        ratio = benchBleedRatio(piece.sensor, sensor);
+        delayMs = BENCH_BLEED_DELAY_US / 1000.0f;
+      }
+      float amplitude = hit.amplitude * ratio;
+      float startMs = hit.timeUs / 1000.0f + delayMs;
+      size_t first = (size_t)(startMs / frameMs);
+      size_t last = min(frameCount, first + (size_t)(piece.decayMs * 8 / frameMs));
+      for (size_t n = first; n < last; n++) {
+        float tMs = n * frameMs + sensor * frameMs / NUM_PADS - startMs;
+        signal[n * NUM_PADS + sensor] += benchEnvelope(amplitude, piece.decayMs, tMs);
+      }
+    }
+
+    // Pico real do sinal no sensor principal, com resolução de 10 µs
+    float truePeak = 0;
+    for (float tMs = 0; tMs < 3 * 1.2f; tMs += 0.01f) {
+      truePeak = max(truePeak, benchEnvelope(hit.amplitude, piece.decayMs, tMs));
+    }
+    SimLabel label = { hit.timeUs, piece.note, (uint8_t)velocityLookup(piece.sensor, min((int)truePeak, 1023)) };
+    labels.push_back(label);
+  }
+
+  frames.resize(frameCount);
+  for (size_t n = 0; n < frameCount; n++) {
+    float hum = benchHumAmplitude * n / frameCount * fabsf(sinf(2.0f * 3.14159265f * 0.06f * n * frameMs));
+    for (uint8_t sensor = 0; sensor < NUM_PADS; sensor++) {
+      float value = signal[n * NUM_PADS + sensor] + hum + benchUniform(0, 4); // Ruído de fundo
+      frames[n].sample[sensor] = (uint16_t)min((int)value, 1023);
+    }
+    frames[n].pedal = SIM_PEDAL_RELEASED;
+    frames[n].choke = 0;
+  }
+  for (size_t h = 0; h < hits.size(); h++) {
+    if (!hits[h].choke) continue;
+    uint16_t bit = 1 << benchPad(benchPieces[hits[h].piece].sensor);
+    size_t first = (hits[h].timeUs + BENCH_CHOKE_DELAY_US) * rateHz / 1000000ULL;
+    size_t last = min(frameCount, (size_t)((hits[h].timeUs + BENCH_CHOKE_DELAY_US + BENCH_CHOKE_HOLD_US) * rateHz / 1000000ULL));
+    for (size_t n = first; n < last; n++) frames[n].choke |= bit;
+  }
+}
+
+/** @brief Compara as notas enviadas com os rótulos e imprime a linha da tabela. */
+static void benchReport(const char *traceName, const BenchConfig &config,
+                        const std::vector<SimLabel> &labels, const std::vector<SimMessage> &messages) {
+  std::vector<bool> matched(labels.size(), false);
+  unsigned detected = 0, doubles = 0, crosstalk = 0;
+  unsigned long velocityErrorSum = 0, velocityErrorMax = 0;
+  uint64_t latencySum = 0, latencyMax = 0;
+
+  for (size_t m = 0; m < messages.size(); m++) {
+    const SimMessage &message = messages[m];
+    if (!message.isNoteOn()) continue;
+    long match = -1;
+    bool repeat = false;
+    for (size_t l = 0; l < labels.size() && labels[l].timeUs <= message.timeUs; l++) {
+      if (labels[l].note != message.data1) continue;
+      uint64_t delay = message.timeUs - labels[l].timeUs;
+      if (delay <= BENCH_MATCH_WINDOW_US && !matched[l]) match = l;
+      else if (delay <= BENCH_DOUBLE_WINDOW_US) repeat = true;
+    }
+    if (match >= 0) {
+      matched[match] = true;
+      detected++;
+      unsigned long error = labs((long)message.data2 - labels[match].velocity);
+      velocityErrorSum += error;
+      velocityErrorMax = max(velocityErrorMax, error);
+      uint64_t latency = message.timeUs - labels[match].timeUs;
+      latencySum += latency;
+      latencyMax = max(latencyMax, latency);
+    } else if (repeat) {
+      doubles++;
+    } else {
+      crosstalk++;
+    }
+  }
+
+  double hits = labels.empty() ? 1 : (double)labels.size();
+  printf("%s\t%lu\t%lu\t%lu\t%lu\t%u\t%.4f\t%.4f\t%.4f\t%.2f\t%lu\t%.0f\t%llu",
+         traceName, config.rateHz, config.peakUs, config.debounceUs, config.repiqueUs,
+         (unsigned)labels.size(), detected / hits, doubles / hits, crosstalk / hits,
+         detected ? (double)velocityErrorSum / detected : 0.0, velocityErrorMax,
+         detected ? (double)latencySum / detected : 0.0, (unsigned long long)latencyMax);
+  for (uint8_t s = 0; s < PROF_STATE_COUNT; s++) {
+    printf("\t%.1f", profStateSteps[s] ? (double)profStateCyclesSum[s] / profStateSteps[s] : 0.0);
+  }
+  printf("\n");
+}
+
+/** @brief Configuração em execução no processo filho. */
+static BenchConfig benchActive;
+
+/** @brief Aplica as janelas de `benchActive` depois do `setup()`. */
+static void benchConfigure() {
+  padWindows.peakDetectionUs = benchActive.peakUs;
+  padWindows.silentDebounceUs = benchActive.debounceUs;
+  padWindows.repiqueCheckUs = benchActive.repiqueUs;
+}
+
+/** @brief Executa uma configuração num processo filho, com o firmware no estado inicial. */
+static void benchRun(const char *traceName, const BenchConfig &config, const std::vector<BenchHit> *hits,
+                     const std::vector<SimFrame> *fileFrames, const std::vector<SimLabel> *fileLabels) {
+  fflush(stdout);
+  pid_t child = fork();
+  if (child < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (child > 0) {
+    int status;
+    waitpid(child, &status, 0);
+    return;
+  }
+
+  benchActive = config;
+  MIDI_PORT.baud = MIDI_TRANSPORT == MIDI_TRANSPORT_DIN ? 31250 : 0;
+
+  std::vector<SimFrame> frames;
+  std::vector<SimLabel> labels;
+  if (hits) {
+    configBegin(); // Os rótulos usam as mesmas tabelas que o firmware
+    velocityLutBegin();
+    benchRender(*hits, config.rateHz, frames, labels);
+  }
+  simReplay(hits ? frames : *fileFrames, config.rateHz, benchLoopPeriodUs, 300000, benchConfigure);
+  benchReport(traceName, config, hits ? labels : *fileLabels, simDecodeMidi(MIDI_PORT.out));
+  fflush(stdout);
+  _exit(0);
+}
+
+/** @brief Lê uma lista de inteiros separados por vírgula. */
+static std::vector<unsigned long> benchParseList(const char *text) {
+  std::vector<unsigned long> values;
+  while (*text) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text) break;
+    if (value) values.push_back(value);
+    text = (*end == ',') ? end + 1 : end;
+  }
+  return values;
+}
+
+int main(int argc, char **argv) {
+  std::vector<unsigned long> rates = benchParseList("5000,10000,20000");
+  std::vector<unsigned long> peaks = benchParseList("2000,4000,7000");
+  std::vector<unsigned long> debounces = benchParseList("15000,30000");
+  std::vector<unsigned long> repiques = benchParseList("100000,180000");
+  unsigned hitCount = 400;
+  unsigned long fileRate = SCAN_SAMPLE_RATE_HZ;
+  std::vector<const char *> paths;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && !strcmp(argv[i], "-r")) rates = benchParseList(argv[++i]);
+    else if (i + 1 < argc && !strcmp(argv[i], "-w")) peaks = benchParseList(argv[++i]);
+    else if (i + 1 < argc && !strcmp(argv[i], "-d")) debounces = benchParseList(argv[++i]);
+    else if (i + 1 < argc && !strcmp(argv[i], "-k")) repiques = benchParseList(argv[++i]);
+    else if (i + 1 < argc && !strcmp(argv[i], "-n")) hitCount = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-s")) benchRandomState = max(1UL, strtoul(argv[++i], NULL, 10));
+    else if (i + 1 < argc && !strcmp(argv[i], "-l")) benchLoopPeriodUs = max(1UL, strtoul(argv[++i], NULL, 10));
+    else if (i + 1 < argc && !strcmp(argv[i], "-f")) fileRate = max(1UL, strtoul(argv[++i], NULL, 10));
+    else if (i + 1 < argc && !strcmp(argv[i], "-z")) benchHumAmplitude = atof(argv[++i]);
+    else if (argv[i][0] != '-') paths.push_back(argv[i]);
+    else {
+      fprintf(stderr, "uso: %s [-r taxas] [-w janelas_pico] [-d debounces] [-k repiques] [-n toques] "
+                      "[-s semente] [-l periodo_loop_us] [-f taxa_arquivos] [-z zumbido] [traços rotulados...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rates.empty() || peaks.empty() || debounces.empty() || repiques.empty()) {
+    fprintf(stderr, "listas de configuração vazias\n");
+    return 2;
+  }
+
+  printf("trace\trate_hz\tpeak_us\tdebounce_us\trepique_us\thits\tdetect_rate\tdouble_rate\txtalk_rate"
+         "\tvel_mae\tvel_max\tlat_mean_us\tlat_max_us"
+         "\tcost_idle\tcost_peak\tcost_debounce\tcost_repique\tcost_choke\n");
+
+  if (paths.empty()) {
+    std::vector<BenchHit> hits = benchGenerateHits(hitCount);
+    for (size_t r = 0; r < rates.size(); r++)
+      for (size_t w = 0; w < peaks.size(); w++)
+        for (size_t d = 0; d < debounces.size(); d++)
+          for (size_t k = 0; k < repiques.size(); k++) {
+            BenchConfig config = { rates[r], peaks[w], debounces[d], repiques[k] };
+            benchRun("synthetic", config, &hits, NULL, NULL);
+          }
+    return 0;
+  }
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    FILE *file = fopen(paths[i], "r");
+    if (!file) {
+      perror(paths[i]);
+      return 1;
+    }
+    std::vector<SimFrame> frames;
+    std::vector<SimLabel> labels;
+    bool ok = simLoadTrace(file, frames, &labels);
+    fclose(file);
+    if (!ok) return 1;
+    for (size_t w = 0; w < peaks.size(); w++)
+      for (size_t d = 0; d < debounces.size(); d++)
+        for (size_t k = 0; k < repiques.size(); k++) {
+          BenchConfig config = { fileRate, peaks[w], debounces[d], repiques[k] };
+          benchRun(paths[i], config, NULL, &frames, &labels);
+        }
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file drum_sim.cpp
+ * @brief Simulador no computador: reproduz um traço gravado dos sensores no firmware.
+ * @details Compila o próprio `main.c` com a camada nativa `sim_hal.h`, injeta as amostras
+ * do traço via scanStoreSample() na taxa de amostragem informada, chama `loop()` no
+ * período configurado e imprime as mensagens MIDI que o firmware transmitiu. Serve para
+ * ajustar limiares e testar mudanças na máquina de estados sem o hardware.
+ *
+ * Compilação (a partir de `doxygen_1.0/sim`):
+ * @code
+ * g++ -std=c++11 -O2 -o drum_sim drum_sim.cpp
+ * g++ -std=c++11 -O2 -DMIDI_TRANSPORT=2 -o drum_sim_din drum_sim.cpp   # MIDI DIN, running status
+ * @endcode
+ *
+ * Uso:
+ * @code
+ * drum_sim [-r taxa_hz] [-l periodo_loop_us] [-b bauds] [-t cauda_ms] [-i entrada.syx] [-o saida.bin] [traço.txt]
+ * @endcode
+ * - `-r`: taxa de amostragem do traço, por sensor (padrão: a informada pela captura
+ *   bruta, ou `SCAN_SAMPLE_RATE_HZ`);
+ * - `-l`: intervalo entre chamadas do `loop()` em µs (padrão: 250);
+ * - `-b`: limita a porta MIDI a essa taxa em bauds (padrão: 31250 no DIN, sem limite na Serial);
+ * - `-t`: tempo extra simulado após o fim do traço, com sensores em zero (padrão: 500 ms);
+ * - `-i`: bytes MIDI recebidos pelo firmware antes do traço (ex.: `F0 7D 20 F7` para calibração);
+ * - `-o`: grava os bytes transmitidos, sem decodificar (ex.: entrada de `xtalk_fit`).
+ *
+ * O traço é lido do arquivo ou da entrada padrão, no formato descrito em `sim_trace.h`,
+ * ou é uma captura bruta gravada do módulo (@ref CAPTURE):
+ * @code
+ * stty -F /dev/ttyACM0 raw && cat /dev/ttyACM0 > captura.bin &
+ * amidi -p hw:1 -S 'F0 7D 26 01 00 02 28 00 50 00 05 06 F7'  # caixa e aro, limiar 256, 40/80 quadros
+ * ./drum_sim captura.bin
+ * @endcode
+ *
+ * Saída: uma linha por mensagem, `tempo_us evento canal dado1 dado2`, onde `evento` é
+ * `on`, `off`, `cc` ou `sysex` (seguido dos bytes em hexadecimal).
+ */
+#include "../main.c"
+#include "sim_trace.h"
+
+#if MIDI_TRANSPORT == MIDI_TRANSPORT_USB
+#error "O simulador modela apenas os transportes seriais (MIDI_TRANSPORT_SERIAL ou MIDI_TRANSPORT_DIN)."
+#endif
+
+/** @brief Imprime uma mensagem decodificada. */
+static void simPrintMessage(const SimMessage &message) {
+  printf("%llu ", (unsigned long long)message.timeUs);
+  if (message.status == 0xF0) {
+    printf("sysex");
+    for (size_t k = 0; k < message.sysex.size(); k++) printf(" %02X", message.sysex[k]);
+    printf("\n");
+    return;
+  }
+  const char *name = "msg";
+  if (message.isNoteOn()) name = "on";
+  else if (message.isNoteOff()) name = "off";
+  else if ((message.status & 0xF0) == 0xB0) name = "cc";
+  printf("%s %u %u %u\n", name, message.status & 0x0F, message.data1, message.data2);
+}
+
+int main(int argc, char **argv) {
+  unsigned long sampleRate = 0;
+  unsigned long loopPeriodUs = 250;
+  unsigned long tailMs = 500;
+  long baud = -1;
+  const char *path = NULL;
+  const char *inputPath = NULL;
+  const char *outputPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && !strcmp(argv[i], "-r")) sampleRate = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-l")) loopPeriodUs = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-b")) baud = strtol(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-t")) tailMs = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-i")) inputPath = argv[++i];
+    else if (i + 1 < argc && !strcmp(argv[i], "-o")) outputPath = argv[++i];
+    else if (argv[i][0] != '-' || !strcmp(argv[i], "-")) path = argv[i];
+    else {
+      fprintf(stderr, "uso: %s [-r taxa_hz] [-l periodo_loop_us] [-b bauds] [-t cauda_ms] [-i entrada.syx] [-o saida.bin] [traço.txt]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (loopPeriodUs == 0) {
+    fprintf(stderr, "o período do loop deve ser positivo\n");
+    return 2;
+  }
+
+  FILE *file = (path && strcmp(path, "-")) ? fopen(path, "rb") : stdin;
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+  std::vector<SimFrame> frames;
+  unsigned long traceRate = SCAN_SAMPLE_RATE_HZ;
+  bool ok = simLoadTrace(file, frames, NULL, &traceRate);
+  if (file != stdin) fclose(file);
+  if (!ok) return 1;
+  if (sampleRate == 0) sampleRate = traceRate;
+
+  if (inputPath) {
+    FILE *input = fopen(inputPath, "rb");
+    if (!input) {
+      perror(inputPath);
+      return 1;
+    }
+    for (int c = fgetc(input); c != EOF; c = fgetc(input)) {
+      uint8_t b = (uint8_t)c;
+      MIDI_PORT.inject(&b, 1);
+    }
+    fclose(input);
+  }
+
+  MIDI_PORT.baud = baud >= 0 ? (unsigned long)baud : (MIDI_TRANSPORT == MIDI_TRANSPORT_DIN ? 31250 : 0);
+  simReplay(frames, sampleRate, loopPeriodUs, (uint64_t)tailMs * 1000);
+
+  if (outputPath) {
+    FILE *output = fopen(outputPath, "wb");
+    if (!output) {
+      perror(outputPath);
+      return 1;
+    }
+    for (size_t i = 0; i < MIDI_PORT.out.size(); i++) fputc(MIDI_PORT.out[i].value, output);
+    fclose(output);
+  }
+
+  std::vector<SimMessage> messages = simDecodeMidi(MIDI_PORT.out);
+  for (size_t i = 0; i < messages.size(); i++) simPrintMessage(messages[i]);
+  return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file sim_hal.h
+ * @brief Implementação nativa da camada de hardware (@ref HAL) para rodar o firmware
+ * no computador.
+ * @details Incluído por `main.c` quando `ARDUINO` não está definido. Substitui a API do
+ * Arduino usada pelo motor de pads por versões em tempo virtual:
+ * - micros()/millis() leem `simTimeUs`, avançado pelo simulador;
+ * - digitalRead() lê `simPinLevel[]`, preenchido a partir do traço;
+ * - `Serial`/`Serial1` gravam os bytes enviados com o instante em que terminam de sair
+ *   na linha (opcionalmente limitados por uma taxa em bauds) e entregam bytes injetados;
+ * - `PROGMEM`, pgm_read_*() e memcpy_P() viram acessos diretos à RAM;
+ * - as funções `eeprom_*()` leem e gravam `simEeprom[]`, que começa apagada (0xFF)
+ *   a cada execução.
+ *
+ * As amostras do ADC não passam por aqui: o simulador chama scanStoreSample()
+ * diretamente, no lugar da interrupção do ADC.
+ *
+ * @note Compilado como uma única unidade de tradução junto com `main.c`, por isso as
+ * variáveis globais são definidas no próprio cabeçalho.
+ * @warning No computador `int` tem 32 bits e `unsigned long` 64 bits. O firmware não
+ * depende de estouro dessas larguras, mas um traço com mais de ~71 minutos não reproduz
+ * a volta do micros() de 32 bits do AVR.
+ */
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <deque>
+#include <vector>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+/** @brief Pinos analógicos com a mesma numeração do Leonardo. */
+enum { A0 = 18, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10, A11 };
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define memcpy_P memcpy
+
+/** @brief Sem interrupções no computador: seções críticas são vazias. */
+#define HAL_ATOMIC_BEGIN()
+#define HAL_ATOMIC_END()
+
+/** @brief Clock simulado da CPU, usado só para o contador de ciclos da instrumentação. */
+#define SIM_F_CPU 16000000UL
+
+/** @brief Número de pinos digitais modelados. */
+#define SIM_NUM_PINS 32
+
+/** @brief Instante virtual atual (µs), controlado pelo simulador. */
+uint64_t simTimeUs = 0;
+/** @brief Nível lido por digitalRead() em cada pino. */
+uint8_t simPinLevel[SIM_NUM_PINS];
+
+inline unsigned long micros() { return (uint32_t)simTimeUs; }
+inline unsigned long millis() { return (uint32_t)(simTimeUs / 1000); }
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < SIM_NUM_PINS && mode == INPUT_PULLUP) simPinLevel[pin] = HIGH;
+}
+inline int digitalRead(uint8_t pin) { return pin < SIM_NUM_PINS ? simPinLevel[pin] : LOW; }
+
+/**
+ * @brief Contador de ciclos usado por profCycles().
+ * @details Por padrão, ciclos de CPU equivalentes ao tempo virtual. Com `SIM_HOST_CYCLES`
+ * em 1, lê o contador de ciclos real do computador (nanossegundos fora do x86), para
+ * medir o custo relativo de cada trecho do firmware (ver `bench.cpp`).
+ */
+#if SIM_HOST_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint32_t simCycles() { return (uint32_t)__rdtsc(); }
+#else
+#include <chrono>
+inline uint32_t simCycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+#else
+inline uint32_t simCycles() { return (uint32_t)(simTimeUs * (SIM_F_CPU / 1000000UL)); }
+#endif
+
+/** @brief Tamanho da EEPROM do ATmega32U4. */
+#define SIM_EEPROM_SIZE 1024
+
+/** @brief Conteúdo da EEPROM simulada. */
+struct SimEeprom {
+  uint8_t data[SIM_EEPROM_SIZE];
+  SimEeprom() { memset(data, 0xFF, sizeof(data)); }
+} simEeprom;
+
+inline uint8_t eeprom_read_byte(const uint8_t *address) {
+  uintptr_t a = (uintptr_t)address;
+  return a < SIM_EEPROM_SIZE ? simEeprom.data[a] : 0xFF;
+}
+inline void eeprom_read_block(void *destination, const void *source, size_t length) {
+  for (size_t i = 0; i < length; i++) ((uint8_t *)destination)[i] = eeprom_read_byte((const uint8_t *)source + i);
+}
+inline void eeprom_update_block(const void *source, void *destination, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    uintptr_t a = (uintptr_t)destination + i;
+    if (a < SIM_EEPROM_SIZE) simEeprom.data[a] = ((const uint8_t *)source)[i];
+  }
+}
+
+/** @brief Byte transmitido pela porta simulada. */
+struct SimByte {
+  uint64_t timeUs; /**< Instante em que o último bit do byte saiu na linha. */
+  uint8_t value;   /**< Valor do byte. */
+};
+
+/**
+ * @brief Porta serial simulada.
+ * @details Com `baud` em zero (padrão) a transmissão é instantânea, como o USB CDC. Com
+ * uma taxa definida, cada byte ocupa 10 bits na linha e o buffer de transmissão tem
+ * `SIM_SERIAL_TX_BUFFER` bytes; se o firmware espera por espaço com o buffer cheio, o
+ * tempo virtual avança até o próximo byte sair, como aconteceria no hardware.
+ */
+class SimSerial {
+ public:
+  static const int SIM_SERIAL_TX_BUFFER = 64; /**< Tamanho do buffer de transmissão. */
+
+  unsigned long baud = 0;        /**< Taxa da linha em bauds (0 = sem limite). */
+  std::vector<SimByte> out;      /**< Todos os bytes enviados, em ordem. */
+
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+
+  size_t write(uint8_t b) {
+    uint64_t t = simTimeUs;
+    if (baud) {
+      drain();
+      if (!pending.empty() && pending.back() > t) t = pending.back();
+      t += 10000000ULL / baud;
+      pending.push_back(t);
+    }
+    out.push_back({ t, b });
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t length) {
+    for (size_t i = 0; i < length; i++) write(buffer[i]);
+    return length;
+  }
+
+  int availableForWrite() {
+    if (!baud) return SIM_SERIAL_TX_BUFFER;
+    drain();
+    if ((int)pending.size() >= SIM_SERIAL_TX_BUFFER) {
+      simTimeUs = pending.front(); // Espera ativa: o tempo passa até liberar um byte
+      drain();
+    }
+    return SIM_SERIAL_TX_BUFFER - (int)pending.size();
+  }
+
+  /** @brief Enfileira bytes para serem lidos pelo firmware (ex.: comandos SysEx). */
+  void inject(const uint8_t *buffer, size_t length) { input.insert(input.end(), buffer, buffer + length); }
+
+  int available() const { return (int)input.size(); }
+
+  int read() {
+    if (input.empty()) return -1;
+    int b = input.front();
+    input.pop_front();
+    return b;
+  }
+
+ private:
+  std::deque<uint64_t> pending; /**< Instantes de fim dos bytes ainda no buffer. */
+  std::deque<uint8_t> input;    /**< Bytes recebidos ainda não lidos. */
+
+  void drain() {
+    while (!pending.empty() && pending.front() <= simTimeUs) pending.pop_front();
+  }
+};
+
+SimSerial Serial;  /**< Porta USB CDC simulada. */
+SimSerial Serial1; /**< UART simulada (MIDI DIN). */
+
+#endif // SIM_HAL_H
@@ -0,0 +1,318 @@
+/**
+ * @file sim_trace.h
+ * @brief Traços de sensores, reprodução no firmware e decodificação da saída MIDI.
+ * @details Compartilhado pelas ferramentas de `sim/`; deve ser incluído depois de
+ * `main.c`, pois usa `NUM_PADS`, scanStoreSample(), `setup()` e `loop()`.
+ *
+ * Formato do traço: uma linha por instante de amostragem, com `NUM_PADS` leituras do ADC
+ * (0-1023) na ordem de @ref PAD_INDICES, seguidas opcionalmente do pedal do chimbal:
+ * o nível do pino (1 = solto, 0 = pressionado) ou, com `PEDAL_CHIMBAL_ANALOG`, a leitura
+ * do ADC do pedal contínuo (padrão: `PEDAL_RAW_OPEN`). Os campos são separados por espaços, tabs ou
+ * vírgulas; linhas iniciadas por `#` são comentários. Um comentário na forma
+ * `#@ hit <tempo_us> <nota> <velocidade>` rotula um toque esperado, usado pela bancada.
+ *
+ * Um arquivo gravado do modo de captura bruta do firmware (@ref CAPTURE) também é aceito
+ * como traço, sem conversão: é reconhecido por não começar com texto.
+ */
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** @brief Valor do pedal nos instantes em que o traço não o informa (pedal solto). */
+#if PEDAL_CHIMBAL_ANALOG
+#define SIM_PEDAL_RELEASED PEDAL_RAW_OPEN
+#else
+#define SIM_PEDAL_RELEASED HIGH
+#endif
+
+/** @brief Um instante do traço: uma leitura por sensor, o pedal e as chaves de choke. */
+struct SimFrame {
+  uint16_t sample[NUM_PADS]; /**< Leitura de cada sensor (@ref PAD_INDICES). */
+  uint16_t pedal;            /**< Nível do pino do pedal do chimbal, ou leitura do pedal contínuo. */
+  uint16_t choke;            /**< Peças com a chave de choke apertada (bit `p` = `padTable[p]`); os arquivos não a informam. */
+};
+static_assert(NUM_KIT_PADS <= 16, "SimFrame::choke tem um bit por peça");
+
+/** @brief Toque esperado num traço rotulado. */
+struct SimLabel {
+  uint64_t timeUs;  /**< Início do toque. */
+  uint8_t note;     /**< Nota que o firmware deve enviar. */
+  uint8_t velocity; /**< Velocidade esperada. */
+};
+
+/** @brief Mensagem MIDI decodificada da saída do firmware. */
+struct SimMessage {
+  uint64_t timeUs;  /**< Instante em que o último byte saiu na linha. */
+  uint8_t status;   /**< Byte de status (0xF0 para SysEx). */
+  uint8_t data1;    /**< Primeiro byte de dados. */
+  uint8_t data2;    /**< Segundo byte de dados. */
+  std::vector<uint8_t> sysex; /**< Conteúdo entre F0 e F7, se for SysEx. */
+
+  bool isNoteOn() const { return (status & 0xF0) == 0x90 && data2 > 0; }
+  bool isNoteOff() const { return (status & 0xF0) == 0x80 || ((status & 0xF0) == 0x90 && data2 == 0); }
+};
+
+#if CAPTURE_ENABLED
+/**
+ * @brief Lê um fluxo da captura bruta (@ref CAPTURE) como traço.
+ * @details Ignora os bytes antes do cabeçalho (no transporte serial, a confirmação SysEx
+ * do comando). Sensores fora da captura ficam em zero, e cada quadro descartado pelo
+ * firmware repete o quadro anterior.
+ * @param file Arquivo já aberto.
+ * @param frames Recebe os quadros lidos.
+ * @param sampleRate Recebe a taxa por sensor informada no cabeçalho (pode ser nulo).
+ * @return `false` se não houver cabeçalho válido.
+ */
+inline bool simLoadCapture(FILE *file, std::vector<SimFrame> &frames, unsigned long *sampleRate) {
+  std::vector<uint8_t> data;
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) data.push_back((uint8_t)c);
+
+  static const uint8_t magic[4] = { 0xDC, 'C', 'A', 'P' };
+  size_t i = 0;
+  while (i + 4 <= data.size() && memcmp(&data[i], magic, 4)) i++;
+  if (i + 7 > data.size() || data[i + 4] != CAPTURE_VERSION) {
+    fprintf(stderr, "captura sem cabeçalho válido (versão %d)\n", CAPTURE_VERSION);
+    return false;
+  }
+  uint8_t channels = data[i + 6];
+  i += 7;
+  if (channels == 0 || channels > CAPTURE_MAX_CHANNELS || i + channels + 6 > data.size()) return false;
+  uint8_t sensor[CAPTURE_MAX_CHANNELS];
+  for (uint8_t c = 0; c < channels; c++) {
+    sensor[c] = data[i++];
+    if (sensor[c] >= NUM_PADS) {
+      fprintf(stderr, "captura com o sensor %u (firmware tem %d)\n", sensor[c], NUM_PADS);
+      return false;
+    }
+  }
+  unsigned long rate = 0;
+  for (uint8_t k = 0; k < 4; k++) rate |= (unsigned long)data[i++] << (8 * k);
+  i += 2; // Quadros antes do disparo: só informativo
+  if (sampleRate && rate) *sampleRate = rate;
+
+  SimFrame frame;
+  memset(frame.sample, 0, sizeof(frame.sample));
+  frame.pedal = SIM_PEDAL_RELEASED;
+  frame.choke = 0;
+  uint16_t previous[CAPTURE_MAX_CHANNELS] = { 0 };
+  uint8_t c = 0;
+  while (i < data.size()) {
+    uint8_t b = data[i++];
+    if (b == CAPTURE_CODE_END) break;
+    if (b == CAPTURE_CODE_GAP) {
+      if (i + 2 > data.size()) break;
+      unsigned lost = data[i] | (data[i + 1] << 8);
+      i += 2;
+      for (unsigned k = 0; k < lost; k++) frames.push_back(frame);
+      continue;
+    }
+    uint16_t value;
+    if (b & CAPTURE_CODE_ABSOLUTE) {
+      if (i >= data.size()) break;
+      value = ((b & 0x07) << 7) | data[i++];
+    } else {
+      value = previous[c] + ((b & 0x40) ? (int)b - 0x80 : (int)b); // 7 bits com sinal
+    }
+    previous[c] = value;
+    frame.sample[sensor[c]] = value;
+    if (++c == channels) {
+      frames.push_back(frame);
+      c = 0;
+    }
+  }
+  return true;
+}
+#endif
+
+/**
+ * @brief Lê um traço no formato descrito acima, ou uma captura bruta do firmware.
+ * @param file Arquivo já aberto.
+ * @param frames Recebe os instantes lidos.
+ * @param labels Recebe os toques rotulados (pode ser nulo).
+ * @param sampleRate Recebe a taxa informada por uma captura bruta (pode ser nulo; os
+ *        traços em texto não a informam e o valor não é alterado).
+ * @return `false` se alguma linha tiver menos de `NUM_PADS` campos.
+ */
+inline bool simLoadTrace(FILE *file, std::vector<SimFrame> &frames, std::vector<SimLabel> *labels,
+                         unsigned long *sampleRate = NULL) {
+#if CAPTURE_ENABLED
+  int first = fgetc(file);
+  if (first == EOF) return true;
+  ungetc(first, file);
+  if (!isprint(first) && !isspace(first)) return simLoadCapture(file, frames, sampleRate);
+#else
+  (void)sampleRate;
+#endif
+  char line[512];
+  unsigned long lineNumber = 0;
+  while (fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    char *cursor = line;
+    while (*cursor == ' ' || *cursor == '\t') cursor++;
+    if (*cursor == '#') {
+      unsigned long long timeUs;
+      unsigned note, velocity;
+      if (labels && sscanf(cursor, "#@ hit %llu %u %u", &timeUs, &note, &velocity) == 3) {
+        SimLabel label = { timeUs, (uint8_t)note, (uint8_t)velocity };
+        labels->push_back(label);
+      }
+      continue;
+    }
+    if (*cursor == '\n' || *cursor == '\r' || *cursor == '\0') continue;
+
+    SimFrame frame;
+    frame.pedal = SIM_PEDAL_RELEASED;
+    frame.choke = 0;
+    int fields = 0;
+    while (fields <= NUM_PADS) {
+      while (*cursor == ' ' || *cursor == '\t' || *cursor == ',') cursor++;
+      char *end;
+      long value = strtol(cursor, &end, 10);
+      if (end == cursor) break;
+      cursor = end;
+      if (fields < NUM_PADS) frame.sample[fields] = (uint16_t)constrain(value, 0L, 1023L);
+      else frame.pedal = PEDAL_CHIMBAL_ANALOG ? (uint16_t)constrain(value, 0L, 1023L) : (value ? HIGH : LOW);
+      fields++;
+    }
+    if (fields < NUM_PADS) {
+      fprintf(stderr, "linha %lu: esperados %d campos, lidos %d\n", lineNumber, NUM_PADS, fields);
+      return false;
+    }
+    frames.push_back(frame);
+  }
+  return true;
+}
+
+/**
+ * @brief Reproduz um traço no firmware.
+ * @details Chama `setup()`, injeta cada instante via scanStoreSample() (e o pedal
+ * contínuo via scanStorePedal(); o digital e as chaves de choke, em `simPinLevel[]`) na
+ * taxa dada e chama `loop()` a cada `loopPeriodUs`. Com `SCAN_SCHEDULING`, cada instante vira uma
+ * passagem de `SCAN_CHANNELS` conversões na ordem da agenda do firmware, com o traço
+ * interpolado entre o instante e o seguinte. Depois do traço, simula `tailUs` com os sensores
+ * em zero e continua até as filas de saída esvaziarem.
+ * @param frames Instantes do traço.
+ * @param sampleRate Taxa de amostragem do traço, por sensor (Hz).
+ * @param loopPeriodUs Intervalo entre chamadas do `loop()`.
+ * @param tailUs Tempo extra simulado após o fim do traço.
+ * @param configure Chamada logo após o `setup()`, para sobrepor a configuração
+ *        carregada por configBegin() (pode ser nula).
+ */
+inline void simReplay(const std::vector<SimFrame> &frames, unsigned long sampleRate,
+                      unsigned long loopPeriodUs, uint64_t tailUs, void (*configure)() = NULL) {
+  simTimeUs = 0;
+  setup();
+  if (configure) configure();
+
+  SimFrame silence;
+  memset(silence.sample, 0, sizeof(silence.sample));
+  silence.pedal = frames.empty() ? SIM_PEDAL_RELEASED : frames.back().pedal;
+  silence.choke = 0;
+  uint64_t totalFrames = frames.size() + tailUs * sampleRate / 1000000ULL;
+  uint64_t nextLoopUs = 0;
+
+  for (uint64_t n = 0; n < totalFrames; n++) {
+    uint64_t frameUs = n * 1000000ULL / sampleRate;
+    const SimFrame &frame = n < frames.size() ? frames[n] : silence;
+
+    // Passagens do loop() que cabem antes deste instante de amostragem
+    while (nextLoopUs < frameUs) {
+      if (simTimeUs < nextLoopUs) simTimeUs = nextLoopUs;
+      loop();
+      nextLoopUs += loopPeriodUs;
+    }
+    if (simTimeUs < frameUs) simTimeUs = frameUs;
+#if PEDAL_CHIMBAL_ANALOG
+    scanStorePedal(frame.pedal);
+#else
+    simPinLevel[PEDAL_CHIMBAL_PIN] = frame.pedal;
+#endif
+    for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+      if (padConfig[p].chokePin < SIM_NUM_PINS) simPinLevel[padConfig[p].chokePin] = (frame.choke >> p) & 1 ? LOW : HIGH;
+    }
+#if SCAN_SCHEDULING
+    const SimFrame &following = n + 1 < frames.size() ? frames[n + 1] : silence;
+    for (uint8_t k = 0; k < SCAN_CHANNELS; k++) {
+      uint8_t channel = scanScheduleNext();
+      if (channel >= NUM_PADS) continue; // Pedal contínuo: já lido acima
+      int from = frame.sample[channel], to = following.sample[channel];
+      scanStoreSample(channel, from + (to - from) * k / SCAN_CHANNELS);
+    }
+#else
+    for (uint8_t pad = 0; pad < NUM_PADS; pad++) scanStoreSample(pad, frame.sample[pad]);
+#endif
+  }
+  // Esvazia as filas de saída
+  while (midiPending()) {
+    if (simTimeUs < nextLoopUs) simTimeUs = nextLoopUs;
+    loop();
+    nextLoopUs += loopPeriodUs;
+  }
+}
+
+/** @brief Tamanho de uma mensagem de canal MIDI pelo byte de status. */
+inline int simMidiLength(uint8_t status) {
+  uint8_t type = status & 0xF0;
+  return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+}
+
+/**
+ * @brief Decodifica o fluxo de bytes transmitido, incluindo running status e SysEx.
+ * @param bytes Bytes na ordem de transmissão, com o instante de cada um.
+ * @return Mensagens completas, em ordem.
+ */
+inline std::vector<SimMessage> simDecodeMidi(const std::vector<SimByte> &bytes) {
+  std::vector<SimMessage> messages;
+  SimMessage message;
+  uint8_t data[2];
+  int length = 0;
+  uint8_t runningStatus = 0;
+  bool inSysex = false;
+
+  for (size_t i = 0; i < bytes.size(); i++) {
+    uint8_t b = bytes[i].value;
+    if (b == 0xF0) {
+      inSysex = true;
+      message.sysex.clear();
+      runningStatus = 0;
+      continue;
+    }
+    if (inSysex) {
+      if (b == 0xF7) {
+        message.timeUs = bytes[i].timeUs;
+        message.status = 0xF0;
+        message.data1 = message.data2 = 0;
+        messages.push_back(message);
+        message.sysex.clear();
+        inSysex = false;
+      } else {
+        message.sysex.push_back(b);
+      }
+      continue;
+    }
+    if (b & 0x80) {
+      if (b >= 0xF8) continue; // Tempo real
+      runningStatus = b;
+      length = 0;
+      continue;
+    }
+    if (!runningStatus) continue; // Dado sem status: descarta
+    data[length++] = b;
+    if (length == simMidiLength(runningStatus) - 1) {
+      message.timeUs = bytes[i].timeUs;
+      message.status = runningStatus;
+      message.data1 = data[0];
+      message.data2 = length > 1 ? data[1] : 0;
+      messages.push_back(message);
+      length = 0;
+    }
+  }
+  return messages;
+}
+
+#endif // SIM_TRACE_H
@@ -0,0 +1,171 @@
+/**
+ * @file xtalk_fit.cpp
+ * @brief Ajusta a matriz de crosstalk a partir de uma captura do modo de calibração.
+ * @details Lê os bytes MIDI recebidos do módulo durante a calibração (@ref CALIBRATION),
+ * agrupa as mensagens `SYSEX_CMD_CALIBRATION_PEAKS` pela peça tocada (a de maior pico)
+ * e, para cada par origem → vítima, calcula:
+ * - razão: maior `pico da vítima / pico da origem` observado, vezes a margem;
+ * - janela: maior atraso do pico da vítima + janela de pico + 5 ms, já que a vítima
+ *   só é avaliada ao fim da sua própria janela de detecção.
+ *
+ * Imprime a matriz ajustada e grava um `SYSEX_CMD_XTALK_SET` por peça com capturas
+ * suficientes, pronto para ser enviado ao módulo. Usa a tabela `padTable[]` do próprio
+ * `main.c` para saber quais sensores formam cada peça.
+ *
+ * Compilação e uso (a partir de `doxygen_1.0/sim`), com as ferramentas do ALSA:
+ * @code
+ * g++ -std=c++11 -O2 -o xtalk_fit xtalk_fit.cpp
+ * amidi -p hw:1 -S 'F0 7D 20 F7'                 # entra no modo de calibração
+ * amidi -p hw:1 -r captura.syx                   # tocar cada peça ~10 vezes, Ctrl+C
+ * ./xtalk_fit -o matriz.syx captura.syx
+ * amidi -p hw:1 -s matriz.syx -S 'F0 7D 21 F7'   # aplica a matriz e sai da calibração
+ * amidi -p hw:1 -S 'F0 7D 33 F7'                 # grava a configuração na EEPROM
+ * @endcode
+ * - `-o`: arquivo de saída com as mensagens SysEx (padrão: só imprime a tabela);
+ * - `-m`: margem multiplicada nas razões (padrão 1.25);
+ * - `-n`: mínimo de capturas por peça para gravar a sua linha (padrão 3);
+ * - `-w`: janela de detecção de pico em µs (padrão: `PEAK_DETECTION_WINDOW_US`).
+ */
+#include "../main.c"
+#include "sim_trace.h"
+
+#include <math.h>
+
+/** @brief Estatísticas de uma peça de origem. */
+struct FitRow {
+  unsigned captures;                 /**< Capturas em que esta peça foi a tocada. */
+  double ratio[NUM_KIT_PADS];        /**< Maior razão vítima/origem observada. */
+  unsigned long delayUs[NUM_KIT_PADS]; /**< Maior atraso do pico da vítima. */
+};
+
+/** @brief Peça de `padTable[]` a que pertence um sensor, ou `NUM_KIT_PADS`. */
+static uint8_t fitPadOfSensor(uint8_t sensor) {
+  for (uint8_t p = 0; p < NUM_KIT_PADS; p++) {
+    PadDescriptor d;
+    memcpy_P(&d, &padTable[p], sizeof(d));
+    for (uint8_t z = 0; z < padZones(d); z++) {
+      if (d.sensor[z] == sensor) return p;
+    }
+  }
+  return NUM_KIT_PADS;
+}
+
+int main(int argc, char **argv) {
+  const char *inputPath = NULL;
+  const char *outputPath = NULL;
+  double margin = 1.25;
+  unsigned minCaptures = 3;
+  unsigned long peakWindowUs = PEAK_DETECTION_WINDOW_US;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && !strcmp(argv[i], "-o")) outputPath = argv[++i];
+    else if (i + 1 < argc && !strcmp(argv[i], "-m")) margin = atof(argv[++i]);
+    else if (i + 1 < argc && !strcmp(argv[i], "-n")) minCaptures = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && !strcmp(argv[i], "-w")) peakWindowUs = strtoul(argv[++i], NULL, 10);
+    else if (argv[i][0] != '-') inputPath = argv[i];
+    else {
+      inputPath = NULL;
+      break;
+    }
+  }
+  if (!inputPath) {
+    fprintf(stderr, "uso: %s [-o matriz.syx] [-m margem] [-n capturas] [-w janela_pico_us] captura.syx\n", argv[0]);
+    return 2;
+  }
+
+  FILE *file = fopen(inputPath, "rb");
+  if (!file) {
+    perror(inputPath);
+    return 1;
+  }
+  std::vector<SimByte> bytes;
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+    SimByte b = { 0, (uint8_t)c };
+    bytes.push_back(b);
+  }
+  fclose(file);
+
+  FitRow rows[NUM_KIT_PADS];
+  memset(rows, 0, sizeof(rows));
+  unsigned total = 0;
+
+  std::vector<SimMessage> messages = simDecodeMidi(bytes);
+  for (size_t m = 0; m < messages.size(); m++) {
+    const std::vector<uint8_t> &x = messages[m].sysex;
+    if (x.size() < 4 || x[0] != SYSEX_MANUFACTURER_ID || x[1] != SYSEX_CMD_CALIBRATION_PEAKS) continue;
+    uint8_t sensors = x[3];
+    if (sensors != NUM_PADS || x.size() < 4 + 5u * sensors) {
+      fprintf(stderr, "captura com %u sensores ignorada (firmware tem %d)\n", sensors, NUM_PADS);
+      continue;
+    }
+
+    // Pico e atraso de cada peça: o maior entre os seus sensores
+    uint16_t padPeak[NUM_KIT_PADS] = { 0 };
+    unsigned long padDelay[NUM_KIT_PADS] = { 0 };
+    for (uint8_t sensor = 0; sensor < NUM_PADS; sensor++) {
+      uint8_t p = fitPadOfSensor(sensor);
+      if (p == NUM_KIT_PADS) continue;
+      uint16_t peak = sysexValue(&x[4 + 5 * sensor], 2);
+      if (peak > padPeak[p]) {
+        padPeak[p] = peak;
+        padDelay[p] = sysexValue(&x[4 + 5 * sensor + 2], 3);
+      }
+    }
+    uint8_t source = 0;
+    for (uint8_t p = 1; p < NUM_KIT_PADS; p++) {
+      if (padPeak[p] > padPeak[source]) source = p;
+    }
+    if (padPeak[source] == 0) continue;
+
+    FitRow &row = rows[source];
+    row.captures++;
+    total++;
+    for (uint8_t v = 0; v < NUM_KIT_PADS; v++) {
+      if (v == source) continue;
+      row.ratio[v] = max(row.ratio[v], (double)padPeak[v] / padPeak[source]);
+      row.delayUs[v] = max(row.delayUs[v], padDelay[v]);
+    }
+  }
+  if (total == 0) {
+    fprintf(stderr, "nenhuma captura de calibração em %s\n", inputPath);
+    return 1;
+  }
+
+  FILE *out = NULL;
+  if (outputPath && !(out = fopen(outputPath, "wb"))) {
+    perror(outputPath);
+    return 1;
+  }
+
+  printf("# origem capturas | razão/janela_ms por vítima (ordem de padTable[])\n");
+  for (uint8_t s = 0; s < NUM_KIT_PADS; s++) {
+    const FitRow &row = rows[s];
+    bool write = row.captures >= minCaptures;
+    printf("%u %u |", s, row.captures);
+    uint8_t message[3 + 4 * NUM_KIT_PADS];
+    uint8_t length = 0;
+    message[length++] = SYSEX_MANUFACTURER_ID;
+    message[length++] = SYSEX_CMD_XTALK_SET;
+    message[length++] = s;
+    for (uint8_t v = 0; v < NUM_KIT_PADS; v++) {
+      unsigned ratioQ8 = 0, windowMs = 0;
+      if (v != s && row.captures) {
+        ratioQ8 = (unsigned)min(255.0, ceil(row.ratio[v] * margin * 256));
+        windowMs = (unsigned)min(255.0, ceil((row.delayUs[v] + peakWindowUs + 5000) / 1000.0));
+      }
+      printf(" %.3f/%u", ratioQ8 / 256.0, windowMs);
+      message[length++] = ratioQ8 & 0x7F;
+      message[length++] = ratioQ8 >> 7;
+      message[length++] = windowMs & 0x7F;
+      message[length++] = windowMs >> 7;
+    }
+    printf(write ? "\n" : "  (poucas capturas, não gravada)\n");
+    if (out && write) {
+      fputc(0xF0, out);
+      fwrite(message, 1, length, out);
+      fputc(0xF7, out);
+    }
+  }
+  if (out) fclose(out);
+  return 0;
+}